@@ -20,9 +20,8 @@ float ellipseSurface(Eigen::Vector3f scale)
 		scale[1] * scale[2];
 }
 
-void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>& leaf_gaussians)
+bool ClusterMerger::cluster(const std::vector<const Gaussian*>& toMerge, Gaussian& clustered)
 {
-	Gaussian clustered;
 	clustered.position = Eigen::Vector3f::Zero();
 	clustered.rotation = Eigen::Vector4f::Zero();
 	clustered.opacity = 0;
@@ -30,24 +29,6 @@ void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>
 	clustered.shs = SHs::Zero();
 	clustered.covariance = Cov::Zero();
 
-	std::vector<const Gaussian*> toMerge;
-	for (auto& child : node->children)
-	{
-		mergeRec(child, leaf_gaussians);
-		if(child->merged.size())
-			toMerge.push_back(&child->merged[0]);
-
-		for (auto& child_leaf : child->leaf_indices)
-			toMerge.push_back(&leaf_gaussians[child_leaf]);
-	}
-
-	if (node->depth == 0) {
-		Eigen::Vector4f diff = node->bounds.maxx - node->bounds.minn;
-		node->bounds.minn.w() = std::min(std::min(diff.x(), diff.y()), diff.z());
-		node->bounds.maxx.w() = std::max(std::max(diff.x(), diff.y()), diff.z());
-		return;
-	}
-
 	float weight_sum = 0;
 	std::vector<float> weights;
 	for (const Gaussian* g : toMerge)
@@ -58,10 +39,7 @@ void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>
 	}
 	if (weight_sum < 1e-10f || std::isnan(weight_sum)) {
 		std::cout << "find Invalid weight: " << weight_sum << std::endl;
-		Eigen::Vector4f diff = node->bounds.maxx - node->bounds.minn;
-		node->bounds.minn.w() = std::min(std::min(diff.x(), diff.y()), diff.z());
-		node->bounds.maxx.w() = std::max(std::max(diff.x(), diff.y()), diff.z());
-		return;
+		return false;
 	}
 	for (int i = 0; i < weights.size(); i++)
 		weights[i] = weights[i] / weight_sum;
@@ -143,6 +121,38 @@ void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>
 
 	clustered.opacity = weight_sum / (ellipseSurface(clustered.scale));
 
+	return true;
+}
+
+void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>& leaf_gaussians)
+{
+	std::vector<const Gaussian*> toMerge;
+	for (auto& child : node->children)
+	{
+		mergeRec(child, leaf_gaussians);
+		if(child->merged.size())
+			toMerge.push_back(&child->merged[0]);
+
+		for (auto& child_leaf : child->leaf_indices)
+			toMerge.push_back(&leaf_gaussians[child_leaf]);
+	}
+
+	if (node->depth == 0) {
+		Eigen::Vector4f diff = node->bounds.maxx - node->bounds.minn;
+		node->bounds.minn.w() = std::min(std::min(diff.x(), diff.y()), diff.z());
+		node->bounds.maxx.w() = std::max(std::max(diff.x(), diff.y()), diff.z());
+		return;
+	}
+
+	Gaussian clustered;
+	if (!cluster(toMerge, clustered))
+	{
+		Eigen::Vector4f diff = node->bounds.maxx - node->bounds.minn;
+		node->bounds.minn.w() = std::min(std::min(diff.x(), diff.y()), diff.z());
+		node->bounds.maxx.w() = std::max(std::max(diff.x(), diff.y()), diff.z());
+		return;
+	}
+
 	node->merged.push_back(clustered);
 
 	//Gaussian g;
@@ -174,4 +184,16 @@ void ClusterMerger::mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>
 void ClusterMerger::merge(ExplicitTreeNode* root, const std::vector<Gaussian>& leaf_gaussians)
 {
 	mergeRec(root, leaf_gaussians);
+}
+
+Gaussian ClusterMerger::mergeGaussians(const std::vector<Gaussian>& gaussians)
+{
+	std::vector<const Gaussian*> toMerge;
+	for (const Gaussian& g : gaussians)
+		toMerge.push_back(&g);
+
+	Gaussian clustered;
+	if (!cluster(toMerge, clustered))
+		throw std::runtime_error("Gaussians to merge have no weight!");
+	return clustered;
 }
\ No newline at end of file
@@ -17,6 +17,10 @@ class ClusterMerger
 {
 private:
 	void mergeRec(ExplicitTreeNode* node, const std::vector<Gaussian>& leaf_gaussians);
+	static bool cluster(const std::vector<const Gaussian*>& gaussians, Gaussian& clustered);
 public:
 	void merge(ExplicitTreeNode* root, const std::vector<Gaussian>& gaussians);
+
+	// Moment matching of the Gaussians, which need their covariance
+	static Gaussian mergeGaussians(const std::vector<Gaussian>& gaussians);
 };
\ No newline at end of file
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "anytime_traversal.h"
+#include "traversal.h"
+#include <algorithm>
+#include <chrono>
+
+#define SCAN_SLICE 4096
+
+AnytimeTraversal::AnytimeTraversal(int N, Node* nodes, Box* boxes) :
+	N(N), nodes(nodes), boxes(boxes), viewpoint(Point::Zero()),
+	split(N, 0), active(N, 0), listed(N, 0)
+{
+}
+
+float AnytimeTraversal::sizeOf(int node_id) const
+{
+	const Box& box = boxes[node_id];
+	return Traversal::computeSize(box, (box.minn.head<3>() + box.maxx.head<3>()) / 2, viewpoint);
+}
+
+void AnytimeTraversal::activate(int node_id)
+{
+	active[node_id] = 1;
+	if (!listed[node_id])
+	{
+		listed[node_id] = 1;
+		active_list.push_back(node_id);
+	}
+}
+
+void AnytimeTraversal::scan(int node_id)
+{
+	const Node& node = nodes[node_id];
+	if (node.depth == 0) // Leaves never split
+		return;
+
+	float size = sizeOf(node_id);
+	if (!split[node_id] && size >= target_size && node.start_children != -1)
+	{
+		to_split.push_back({ size, node_id });
+		std::push_heap(to_split.begin(), to_split.end());
+		round_dirty = true;
+	}
+	else if (split[node_id] && size < target_size)
+	{
+		to_collapse.push_back({ -size, node_id });
+		std::push_heap(to_collapse.begin(), to_collapse.end());
+		round_dirty = true;
+	}
+}
+
+int AnytimeTraversal::splitNode(int node_id)
+{
+	split[node_id] = 1;
+
+	// Children are checked right away so that refinement can continue downwards
+	const Node& node = nodes[node_id];
+	for (int i = 0; i < node.count_children; i++)
+	{
+		activate(node.start_children + i);
+		scan(node.start_children + i);
+	}
+	return node.count_children;
+}
+
+int AnytimeTraversal::collapseNode(int node_id)
+{
+	split[node_id] = 0;
+
+	int visited = 0;
+	const Node& node = nodes[node_id];
+	for (int i = 0; i < node.count_children; i++)
+		stack.push_back(node.start_children + i);
+
+	while (!stack.empty())
+	{
+		int child_id = stack.back();
+		stack.pop_back();
+		visited++;
+
+		active[child_id] = 0;
+		if (split[child_id])
+		{
+			split[child_id] = 0;
+			const Node& child = nodes[child_id];
+			for (int i = 0; i < child.count_children; i++)
+				stack.push_back(child.start_children + i);
+		}
+	}
+	return visited;
+}
+
+void AnytimeTraversal::finishRound()
+{
+	size_t kept = 0;
+	for (int node_id : active_list)
+	{
+		if (active[node_id])
+			active_list[kept++] = node_id;
+		else
+			listed[node_id] = 0;
+	}
+	active_list.resize(kept);
+	cursor = 0;
+
+	is_converged = !round_dirty && to_split.empty() && to_collapse.empty();
+	round_dirty = false;
+}
+
+bool AnytimeTraversal::update(const Point& viewpoint, float target_size, int max_nodes, float max_microseconds)
+{
+	// Nodes checked earlier in the current round are outdated. Without a cut
+	// there is no previous view to compare with.
+	if (active_list.empty() || viewpoint != this->viewpoint || target_size != this->target_size)
+	{
+		is_converged = false;
+		round_dirty = true;
+	}
+	this->viewpoint = viewpoint;
+	this->target_size = target_size;
+
+	if (active_list.empty())
+		activate(0);
+
+	auto begin = std::chrono::steady_clock::now();
+	int work = 0;
+	auto withinBudget = [&]() {
+		if (work >= max_nodes)
+			return false;
+		if (max_microseconds > 0 && (work & 15) == 0)
+			return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - begin).count() < max_microseconds;
+		return true;
+	};
+
+	// At most one pass over the cut per call, a converged cut costs one scan
+	size_t scanned = 0;
+	bool scan_done = false;
+
+	while (withinBudget())
+	{
+		// Check a slice of the cut, then apply what it found in priority order.
+		// Slices are bounded so that a time budget still leaves room for changes.
+		int slice_end = work + std::min(SCAN_SLICE, std::max(1, (max_nodes - work) / 2));
+		while (!scan_done && work < slice_end && withinBudget())
+		{
+			if (cursor >= active_list.size())
+			{
+				finishRound();
+				scan_done = scanned >= active_list.size() || is_converged;
+				continue;
+			}
+
+			int node_id = active_list[cursor++];
+			if (!active[node_id])
+				continue;
+			scan(node_id);
+			scanned++;
+			work++;
+		}
+
+		while (withinBudget() && (!to_collapse.empty() || !to_split.empty()))
+		{
+			// Queued entries may be outdated, the decision is re-checked for the current view
+			bool collapse = !to_collapse.empty();
+			std::vector<Candidate>& queue = collapse ? to_collapse : to_split;
+			std::pop_heap(queue.begin(), queue.end());
+			int node_id = queue.back().node_id;
+			queue.pop_back();
+			work++;
+
+			if (!active[node_id] || split[node_id] != collapse)
+				continue;
+			float size = sizeOf(node_id);
+			if (collapse && size < target_size)
+				work += collapseNode(node_id);
+			else if (!collapse && size >= target_size)
+				work += splitNode(node_id);
+		}
+
+		if (scan_done && to_collapse.empty() && to_split.empty())
+			break;
+	}
+
+	return is_converged;
+}
+
+int AnytimeTraversal::getRenderIndices(
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices)
+{
+	sorted.clear();
+	for (int node_id : active_list)
+		if (active[node_id])
+			sorted.push_back(node_id);
+	std::sort(sorted.begin(), sorted.end());
+
+	int num_active = sorted.size();
+	if (num_active == 0)
+		return 0;
+
+	render_offsets.resize(num_active);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < num_active; idx++)
+	{
+		int node_id = sorted[idx];
+		const Node& node = nodes[node_id];
+		int count = node.count_leafs;
+		if (node.depth > 0 && split[node_id] == 0)
+			count += node.count_merged;
+		render_offsets[idx] = count;
+	}
+
+	return Traversal::putRenderIndices(nodes, num_active, sorted.data(), render_offsets.data(), render_indices, parent_indices, nodes_of_render_indices);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include "common.h"
+
+// Traversal with a bounded amount of work per call. The cut follows the same
+// rules as IncrementalTraversal (active nodes are the root and all children of
+// split nodes, a node is split when its size reaches the target), but every
+// update() only visits a limited number of nodes or runs for a limited time.
+//
+// Each call re-checks a slice of the active nodes, continuing where the last
+// call stopped, and queues the nodes that should change. Collapses are applied
+// smallest size first, splits largest size first, so the most visible detail
+// arrives first. The cut stays valid after every call and the queues are kept
+// for the next one, so detail converges over a few frames after a camera jump.
+class AnytimeTraversal
+{
+public:
+	AnytimeTraversal(int N, Node* nodes, Box* boxes);
+
+	// Visits at most max_nodes nodes and stops after max_microseconds (0 for no
+	// time limit). Returns true once a full pass over the cut found nothing to change.
+	bool update(const Point& viewpoint, float target_size, int max_nodes, float max_microseconds = 0.0f);
+
+	// Same layout as putRenderIndicesIndexed, ordered by node id
+	int getRenderIndices(
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_of_render_indices = nullptr);
+
+	bool converged() const { return is_converged; }
+	const std::vector<char>& splitState() const { return split; }
+
+private:
+
+	struct Candidate
+	{
+		float priority;
+		int node_id;
+
+		bool operator<(const Candidate& other) const { return priority < other.priority; }
+	};
+
+	float sizeOf(int node_id) const;
+	void scan(int node_id);
+	int splitNode(int node_id);
+	int collapseNode(int node_id);
+	void activate(int node_id);
+	void finishRound();
+
+	int N;
+	Node* nodes;
+	Box* boxes;
+
+	Point viewpoint;
+	float target_size = -1.0f;
+
+	std::vector<char> split;
+	std::vector<char> active;
+	std::vector<char> listed;
+
+	// Active nodes in scan order, entries of deactivated nodes are dropped at the end of a round
+	std::vector<int> active_list;
+	size_t cursor = 0;
+	bool round_dirty = false;
+	bool is_converged = false;
+
+	std::vector<Candidate> to_split;
+	std::vector<Candidate> to_collapse;
+	std::vector<int> stack;
+	std::vector<int> sorted;
+	std::vector<int> render_offsets;
+};
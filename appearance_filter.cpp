@@ -20,20 +20,6 @@
 #include <numeric>
 #include "runtime_switching.h"
 
-template <typename T>
-T ReadBinaryLittleEndian(std::ifstream* infile)
-{
-	T val;
-	infile->read((char*)&val, sizeof(T));
-	return val;
-}
-
-template <typename T>
-void ReadBinaryLittleEndian(std::ifstream* infile, std::vector<T>* vals)
-{
-	infile->read((char*)vals->data(), sizeof(T) * vals->size());
-}
-
 void AppearanceFilter::init(const char* colmappath)
 {
 	const std::string basePathName = std::string(colmappath) + "/sparse/0/";
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "chunk_splitter.h"
+#include "loader.h"
+#include "hierarchy_explicit_loader.h"
+#include "common.h"
+#include <omp.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#define SPLIT_BLOCK (1 << 18)
+#define SPLIT_SAMPLE (1 << 20)
+
+// Width the vertex count is padded to, so it can be patched once known
+#define COUNT_WIDTH 20
+
+// Sequential reader over the vertices of the input, in the layout of the
+// ply files written for the chunks. The position comes first in all of them.
+class VertexReader
+{
+public:
+	VertexReader(const std::string& filename)
+	{
+		std::string ext = filename.substr(filename.size() - 4);
+		if (ext == ".ply")
+		{
+			count = Loader::openPly(filename.c_str(), infile, properties);
+			data_start = infile.tellg();
+			record_size = properties.size() * sizeof(float);
+		}
+		else
+		{
+			// .bin stores each attribute for all Gaussians in turn
+			infile.open(filename, std::ios_base::binary);
+			if (!infile.good())
+				throw std::runtime_error("File not found!");
+			int P;
+			infile.read((char*)&P, sizeof(int));
+			count = P;
+			data_start = infile.tellg();
+			is_bin = true;
+
+			const char* names[] = { "x", "y", "z", "nx", "ny", "nz", "f_dc_0", "f_dc_1", "f_dc_2" };
+			for (const char* name : names)
+				properties.push_back(std::string("property float ") + name);
+			for (int j = 0; j < 45; j++)
+				properties.push_back("property float f_rest_" + std::to_string(j));
+			for (const char* name : { "opacity", "scale_0", "scale_1", "scale_2", "rot_0", "rot_1", "rot_2", "rot_3" })
+				properties.push_back(std::string("property float ") + name);
+			record_size = sizeof(RichPoint);
+		}
+		rewind();
+	}
+
+	void rewind()
+	{
+		infile.clear();
+		infile.seekg(data_start);
+		next = 0;
+	}
+
+	// Reads up to max_count following vertices, returns how many were read
+	size_t read(size_t max_count, std::vector<char>& records)
+	{
+		size_t n = std::min(max_count, count - next);
+		records.resize(n * record_size);
+		if (!is_bin)
+		{
+			infile.read(records.data(), n * record_size);
+		}
+		else
+		{
+			pos.resize(n);
+			shs.resize(n);
+			alphas.resize(n);
+			scales.resize(n);
+			rot.resize(n);
+			readSection(0, sizeof(Eigen::Vector3f), n, pos.data());
+			readSection(sizeof(Eigen::Vector3f), sizeof(SHs), n, shs.data());
+			readSection(sizeof(Eigen::Vector3f) + sizeof(SHs), sizeof(float), n, alphas.data());
+			readSection(sizeof(Eigen::Vector3f) + sizeof(SHs) + sizeof(float), sizeof(Eigen::Vector3f), n, scales.data());
+			readSection(2 * sizeof(Eigen::Vector3f) + sizeof(SHs) + sizeof(float), sizeof(Eigen::Vector4f), n, rot.data());
+
+			// Same layout as the degree 3 ply files of Writer::writePly
+			RichPoint* points = (RichPoint*)records.data();
+			for (size_t i = 0; i < n; i++)
+			{
+				RichPoint& p = points[i];
+				p.position = pos[i];
+				p.normal = Eigen::Vector3f(0, 0, 0);
+				for (int j = 0; j < 3; j++)
+					p.shs[j] = shs[i][j];
+				for (int j = 1; j < 16; j++)
+				{
+					p.shs[(j - 1) + 3] = shs[i][j * 3 + 0];
+					p.shs[(j - 1) + 18] = shs[i][j * 3 + 1];
+					p.shs[(j - 1) + 33] = shs[i][j * 3 + 2];
+				}
+				p.opacity = alphas[i];
+				p.scale = scales[i];
+				for (int j = 0; j < 4; j++)
+					p.rotation[j] = rot[i][j];
+			}
+		}
+		if (!infile.good())
+			throw std::runtime_error("Failed to read vertices!");
+		next += n;
+		return n;
+	}
+
+	static Eigen::Vector3f position(const char* record)
+	{
+		const float* p = (const float*)record;
+		return Eigen::Vector3f(p[0], p[1], p[2]);
+	}
+
+	size_t count;
+	size_t record_size;
+	std::vector<std::string> properties;
+
+private:
+	// The section of an attribute of size bytes starts at offset * count
+	void readSection(size_t offset, size_t size, size_t n, void* dst)
+	{
+		infile.seekg(data_start + std::streamoff(offset * count + size * next));
+		infile.read((char*)dst, n * size);
+	}
+
+	std::ifstream infile;
+	std::streamoff data_start;
+	size_t next = 0;
+	bool is_bin = false;
+
+	std::vector<Eigen::Vector3f> pos;
+	std::vector<SHs> shs;
+	std::vector<float> alphas;
+	std::vector<Eigen::Vector3f> scales;
+	std::vector<Eigen::Vector4f> rot;
+};
+
+ChunkSplitter::ChunkSplitter(const char* filename) :
+	filename(filename),
+	minn(FLT_MAX, FLT_MAX, FLT_MAX),
+	maxx(-FLT_MAX, -FLT_MAX, -FLT_MAX)
+{
+	VertexReader reader(filename);
+	count = reader.count;
+	if (count == 0)
+		throw std::runtime_error("Input has no vertices");
+
+	// Uniform sample of the positions, with a fixed seed so splits repeat
+	std::mt19937_64 rng(0);
+	std::vector<char> records;
+	size_t seen = 0;
+	while (size_t n = reader.read(SPLIT_BLOCK, records))
+	{
+		for (size_t i = 0; i < n; i++, seen++)
+		{
+			Eigen::Vector3f pos = VertexReader::position(records.data() + i * reader.record_size);
+			minn = minn.cwiseMin(pos);
+			maxx = maxx.cwiseMax(pos);
+
+			if (sample.size() < SPLIT_SAMPLE)
+			{
+				sample.push_back(pos);
+			}
+			else
+			{
+				size_t k = std::uniform_int_distribution<size_t>(0, seen)(rng);
+				if (k < SPLIT_SAMPLE)
+					sample[k] = pos;
+			}
+		}
+	}
+}
+
+int ChunkSplitter::buildKd(size_t begin, size_t end, const Eigen::Vector3f& lo, const Eigen::Vector3f& hi, size_t target_count)
+{
+	int current = (int)regions.size();
+	regions.push_back(Region());
+
+	// Vertices of the input the sample range stands for
+	double estimate = (end - begin) * (double)count / sample.size();
+	if (estimate <= target_count || end - begin < 2)
+	{
+		regions[current].left = (int)chunks.size();
+		chunks.push_back({ std::to_string(chunks.size()), lo, hi, (lo + hi) / 2 });
+		return current;
+	}
+
+	int axis;
+	(hi - lo).maxCoeff(&axis);
+	size_t mid = (begin + end) / 2;
+	std::nth_element(sample.begin() + begin, sample.begin() + mid, sample.begin() + end,
+		[&](const Eigen::Vector3f& a, const Eigen::Vector3f& b) { return a[axis] < b[axis]; });
+	float split = sample[mid][axis];
+
+	Eigen::Vector3f left_hi = hi, right_lo = lo;
+	left_hi[axis] = split;
+	right_lo[axis] = split;
+	int left = buildKd(begin, mid, lo, left_hi, target_count);
+	int right = buildKd(mid, end, right_lo, hi, target_count);
+
+	regions[current].axis = axis;
+	regions[current].split = split;
+	regions[current].left = left;
+	regions[current].right = right;
+	return current;
+}
+
+void ChunkSplitter::partitionKd(size_t target_count)
+{
+	if (target_count == 0)
+		throw std::runtime_error("Target count must be positive");
+	chunks.clear();
+	regions.clear();
+	buildKd(0, sample.size(), minn, maxx, target_count);
+	std::cout << "Kd partition: " << chunks.size() << " chunks" << std::endl;
+}
+
+void ChunkSplitter::partitionGrid(float size)
+{
+	if (size <= 0)
+		throw std::runtime_error("Cell size must be positive");
+	chunks.clear();
+	regions.clear();
+	cell_size = size;
+
+	// Longest two axes, usually the ground plane
+	Eigen::Vector3f extent = maxx - minn;
+	int order[3] = { 0, 1, 2 };
+	std::sort(order, order + 3, [&](int a, int b) { return extent[a] > extent[b]; });
+	for (int k = 0; k < 2; k++)
+	{
+		grid_axes[k] = order[k];
+		grid_cells[k] = std::max(1, (int)std::ceil(extent[order[k]] / cell_size));
+	}
+
+	for (int i = 0; i < grid_cells[0]; i++)
+	{
+		for (int j = 0; j < grid_cells[1]; j++)
+		{
+			Chunk chunk;
+			chunk.name = std::to_string(i) + "_" + std::to_string(j);
+			chunk.minn = minn;
+			chunk.maxx = maxx;
+			chunk.center = (minn + maxx) / 2;
+			int cell[2] = { i, j };
+			for (int k = 0; k < 2; k++)
+			{
+				int axis = grid_axes[k];
+				chunk.minn[axis] = minn[axis] + cell[k] * cell_size;
+				chunk.maxx[axis] = std::min(maxx[axis], minn[axis] + (cell[k] + 1) * cell_size);
+				chunk.center[axis] = minn[axis] + (cell[k] + 0.5f) * cell_size;
+			}
+			chunks.push_back(chunk);
+		}
+	}
+	std::cout << "Grid partition: " << grid_cells[0] << " x " << grid_cells[1] << " chunks" << std::endl;
+}
+
+// Chunk whose box contains pos, the closest cell for positions off the grid
+int ChunkSplitter::locate(const Eigen::Vector3f& pos) const
+{
+	if (regions.empty())
+	{
+		int cell[2];
+		for (int k = 0; k < 2; k++)
+		{
+			int axis = grid_axes[k];
+			cell[k] = std::min(grid_cells[k] - 1, std::max(0, (int)std::floor((pos[axis] - minn[axis]) / cell_size)));
+		}
+		return cell[0] * grid_cells[1] + cell[1];
+	}
+
+	int node = 0;
+	while (regions[node].axis != -1)
+		node = pos[regions[node].axis] < regions[node].split ? regions[node].left : regions[node].right;
+	return regions[node].left;
+}
+
+// The chunks the merger weighs pos into come first, the one with the nearest
+// center leading, then the other written chunks whose box grown by the margin
+// contains pos
+void ChunkSplitter::assign(const Eigen::Vector3f& pos, float margin, std::vector<int>& chunk_ids) const
+{
+	chunk_ids.clear();
+
+	// The nearest center always gets a positive weight, any other one is
+	// weighed against the distance to the nearest
+	int K = (int)centers.size();
+	int nearest = 0;
+	float nearest_dist = FLT_MAX;
+	for (int k = 0; k < K; k++)
+	{
+		float dist = (pos - centers[k]).norm();
+		if (dist < nearest_dist)
+		{
+			nearest_dist = dist;
+			nearest = k;
+		}
+	}
+	chunk_ids.push_back(center_ids[nearest]);
+	for (int k = 0; k < K; k++)
+		if (k != nearest && HierarchyExplicitLoader::getWeight((pos - centers[k]).norm(), nearest_dist) > 0.f)
+			chunk_ids.push_back(center_ids[k]);
+
+	auto add = [&](int chunk_id) {
+		if (written_chunks[chunk_id] && std::find(chunk_ids.begin(), chunk_ids.end(), chunk_id) == chunk_ids.end())
+			chunk_ids.push_back(chunk_id);
+	};
+
+	if (regions.empty())
+	{
+		int lo[2], hi[2];
+		for (int k = 0; k < 2; k++)
+		{
+			int axis = grid_axes[k];
+			auto cell = [&](float x) { return std::min(grid_cells[k] - 1, std::max(0, (int)std::floor((x - minn[axis]) / cell_size))); };
+			lo[k] = cell(pos[axis] - margin);
+			hi[k] = cell(pos[axis] + margin);
+		}
+		for (int i = lo[0]; i <= hi[0]; i++)
+			for (int j = lo[1]; j <= hi[1]; j++)
+				add(i * grid_cells[1] + j);
+		return;
+	}
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Region& region = regions[stack[--top]];
+		if (region.axis == -1)
+		{
+			add(region.left);
+			continue;
+		}
+		float x = pos[region.axis];
+		if (x < region.split + margin)
+			stack[top++] = region.left;
+		if (x >= region.split - margin)
+			stack[top++] = region.right;
+	}
+}
+
+std::vector<std::string> ChunkSplitter::write(const std::string& output_dir, float margin)
+{
+	int C = (int)chunks.size();
+	if (C == 0)
+		throw std::runtime_error("No partition computed");
+
+	// Chunks without sampled vertices are left out, so the vertices are only
+	// weighed against the centers the merger reads
+	written_chunks.assign(C, 0);
+	for (const Eigen::Vector3f& pos : sample)
+		written_chunks[locate(pos)] = 1;
+	center_ids.clear();
+	centers.clear();
+	for (int c = 0; c < C; c++)
+	{
+		if (!written_chunks[c])
+			continue;
+		center_ids.push_back(c);
+		centers.push_back(chunks[c].center);
+	}
+
+	VertexReader reader(filename);
+	size_t record_size = reader.record_size;
+
+	auto plyPath = [&](int chunk_id) { return output_dir + "/" + chunks[chunk_id].name + "/point_cloud.ply"; };
+	std::string header_start = "ply\nformat binary_little_endian 1.0\nelement vertex ";
+
+	std::vector<size_t> written(C, 0), own(C, 0);
+	int num_threads = omp_get_max_threads();
+	std::vector<std::vector<std::pair<int, int>>> thread_pairs(num_threads); // chunk, vertex in block
+	std::vector<int> offsets(C + 1);
+	std::vector<int> order;
+	std::vector<char> records;
+
+	while (size_t n = reader.read(SPLIT_BLOCK, records))
+	{
+		// Chunks of each vertex, threads take contiguous ranges to keep the input order
+#pragma omp parallel
+		{
+			std::vector<std::pair<int, int>>& pairs = thread_pairs[omp_get_thread_num()];
+			pairs.clear();
+			std::vector<int> chunk_ids;
+#pragma omp for schedule(static)
+			for (long long i = 0; i < (long long)n; i++)
+			{
+				assign(VertexReader::position(records.data() + i * record_size), margin, chunk_ids);
+				for (int chunk_id : chunk_ids)
+					pairs.push_back(std::make_pair(chunk_id, (int)i));
+			}
+		}
+
+		// Vertices grouped by chunk
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (auto& pairs : thread_pairs)
+			for (auto& p : pairs)
+				offsets[p.first + 1]++;
+		for (int c = 0; c < C; c++)
+			offsets[c + 1] += offsets[c];
+		order.resize(offsets[C]);
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (auto& pairs : thread_pairs)
+			for (auto& p : pairs)
+				order[fill[p.first]++] = p.second;
+
+		// One thread per chunk file, opened only while appending
+		std::vector<std::string> errors(C);
+#pragma omp parallel
+		{
+			std::vector<char> buffer;
+#pragma omp for schedule(dynamic, 1)
+			for (int c = 0; c < C; c++)
+			{
+				int begin = offsets[c], end = offsets[c + 1];
+				if (begin == end)
+					continue;
+
+				buffer.resize((end - begin) * record_size);
+				for (int k = begin; k < end; k++)
+					std::copy_n(records.data() + order[k] * record_size, record_size, buffer.data() + (k - begin) * record_size);
+
+				std::ofstream outfile;
+				if (written[c] == 0)
+				{
+					std::filesystem::create_directories(output_dir + "/" + chunks[c].name);
+					outfile.open(plyPath(c), std::ios_base::binary);
+					outfile << header_start << std::left << std::setw(COUNT_WIDTH) << 0 << "\n";
+					for (const std::string& property : reader.properties)
+						outfile << property << "\n";
+					outfile << "end_header\n";
+				}
+				else
+				{
+					outfile.open(plyPath(c), std::ios_base::binary | std::ios_base::app);
+				}
+				outfile.write(buffer.data(), buffer.size());
+				if (!outfile.good())
+					errors[c] = "Failed to write " + plyPath(c);
+				written[c] += end - begin;
+			}
+		}
+		for (const std::string& error : errors)
+			if (!error.empty())
+				throw std::runtime_error(error);
+
+		// The first chunk of each vertex, the nearest center, is its own
+		for (auto& pairs : thread_pairs)
+		{
+			int last = -1;
+			for (auto& p : pairs)
+			{
+				if (p.second != last)
+					own[p.first]++;
+				last = p.second;
+			}
+		}
+	}
+
+	// Patch the vertex counts. Centers are written exactly, as they were weighed.
+	std::vector<std::string> names;
+	for (int c = 0; c < C; c++)
+	{
+		if (written[c] == 0)
+			continue;
+
+		std::fstream plyfile(plyPath(c), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+		plyfile.seekp(header_start.size());
+		plyfile << std::left << std::setw(COUNT_WIDTH) << written[c];
+
+		const Eigen::Vector3f& center = chunks[c].center;
+		std::ofstream centerfile(output_dir + "/" + chunks[c].name + "/center.txt");
+		centerfile << std::setprecision(std::numeric_limits<float>::max_digits10);
+		centerfile << center[0] << " " << center[1] << " " << center[2] << std::endl;
+
+		names.push_back(chunks[c].name);
+		std::cout << "Chunk " << chunks[c].name << ": " << own[c] << " vertices, " << written[c] - own[c] << " in the margin or blend region" << std::endl;
+	}
+	return names;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <Eigen/Dense>
+
+// Splits a trained scene (.ply or .bin) into spatial chunks for the merger,
+// without holding the scene in memory. The constructor streams the input
+// once for its bounds and a fixed size sample of positions, the partition is
+// computed on the sample. write streams the input again in blocks and
+// appends each vertex to every chunk whose box, grown by the margin,
+// contains it, and to every chunk the merger keeps Gaussians at its position
+// for (HierarchyExplicitLoader::getWeight against the chunk centers > 0).
+// Vertices are copied as they are; .bin input is written in the degree 3 ply
+// layout. Memory is bounded by the sample and the block size.
+class ChunkSplitter
+{
+public:
+	ChunkSplitter(const char* filename);
+
+	// Kd-tree on the sample, split at the median of the longest axis until
+	// a chunk holds about target_count vertices at most
+	void partitionKd(size_t target_count);
+
+	// Square cells on the two longest axes of the bounds, the third is not split
+	void partitionGrid(float cell_size);
+
+	// Writes <output_dir>/<name>/point_cloud.ply and center.txt for every
+	// chunk holding sampled vertices, the others are left out of the centers
+	// the vertices are weighed against. Returns the names of the chunks written.
+	std::vector<std::string> write(const std::string& output_dir, float margin);
+
+	size_t numVertices() const { return count; }
+	int numChunks() const { return (int)chunks.size(); }
+
+private:
+	struct Chunk
+	{
+		std::string name;
+		Eigen::Vector3f minn, maxx;
+		Eigen::Vector3f center; // of the box, unclipped for grid cells
+	};
+
+	struct Region
+	{
+		int axis = -1; // -1 for a chunk
+		float split;
+		int left, right; // children, or the chunk id in left
+	};
+
+	int buildKd(size_t begin, size_t end, const Eigen::Vector3f& minn, const Eigen::Vector3f& maxx, size_t target_count);
+	int locate(const Eigen::Vector3f& pos) const;
+	void assign(const Eigen::Vector3f& pos, float margin, std::vector<int>& chunk_ids) const;
+
+	std::string filename;
+	size_t count = 0;
+	Eigen::Vector3f minn, maxx;
+	std::vector<Eigen::Vector3f> sample;
+
+	std::vector<Chunk> chunks;
+	std::vector<Region> regions; // kd partition, empty for a grid
+	std::vector<char> written_chunks; // chunks holding sampled vertices
+	std::vector<int> center_ids; // the written chunks
+	std::vector<Eigen::Vector3f> centers; // and their centers as written to center.txt
+	int grid_axes[2];
+	int grid_cells[2];
+	float cell_size;
+};
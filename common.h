@@ -16,12 +16,29 @@
 #include "types.h"
 #include <float.h>
 #include <memory>
+#include <fstream>
+#include <vector>
 
 static float sigmoid(const float m1)
 {
 	return 1.0f / (1.0f + exp(-m1));
 }
 
+// Readers for COLMAP's binary model files
+template <typename T>
+T ReadBinaryLittleEndian(std::ifstream* infile)
+{
+	T val;
+	infile->read((char*)&val, sizeof(T));
+	return val;
+}
+
+template <typename T>
+void ReadBinaryLittleEndian(std::ifstream* infile, std::vector<T>* vals)
+{
+	infile->read((char*)vals->data(), sizeof(T) * vals->size());
+}
+
 
 typedef Eigen::Matrix<float, 6, 1> Cov;
 typedef Eigen::Vector3f Point;
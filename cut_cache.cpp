@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "cut_cache.h"
+#include "traversal.h"
+#include <cmath>
+#include <cstring>
+
+// Per node state of a cached cut
+#define CUT_NONE 0
+#define CUT_LEAFS 1
+#define CUT_LEAFS_MERGED 2
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static uint32_t getVarint(const uint8_t*& in)
+{
+	uint32_t value = 0;
+	int shift = 0;
+	while (*in & 0x80)
+	{
+		value |= (uint32_t)(*in++ & 0x7f) << shift;
+		shift += 7;
+	}
+	value |= (uint32_t)(*in++) << shift;
+	return value;
+}
+
+// reachesSize for the closest viewpoint of the cell
+static bool reachesSizeInCell(const Box& box, const Point& point, float t2, const Point& cell_min, const Point& cell_max)
+{
+	Point diff = (cell_min - point).cwiseMax(point - cell_max).cwiseMax(Point::Zero());
+	if (diff.squaredNorm() * t2 <= box.maxx[3] * box.maxx[3])
+		return true;
+	return (cell_max.array() >= box.minn.head<3>().array()).all() && (cell_min.array() <= box.maxx.head<3>().array()).all();
+}
+
+size_t CutCache::KeyHash::operator()(const Key& key) const
+{
+	uint32_t t;
+	std::memcpy(&t, &key.target_size, sizeof(float));
+	size_t h = (size_t)(uint32_t)key.x * 73856093u;
+	h ^= (size_t)(uint32_t)key.y * 19349663u;
+	h ^= (size_t)(uint32_t)key.z * 83492791u;
+	h ^= (size_t)t * 2654435761u;
+	return h;
+}
+
+CutCache::CutCache(int N, Node* nodes, Box* boxes, float cell_size, size_t max_bytes) :
+	N(N), nodes(nodes), boxes(boxes), cell_size(cell_size), max_bytes(max_bytes)
+{
+}
+
+void CutCache::clear()
+{
+	entries.clear();
+	lookup.clear();
+	used_bytes = 0;
+}
+
+void CutCache::computeCut(const Key& key, Entry& entry)
+{
+	Point cell_min = Point(key.x, key.y, key.z) * cell_size;
+	Point cell_max = cell_min + Point::Constant(cell_size);
+	float t2 = Traversal::squaredTarget(key.target_size);
+
+	flags.resize(N);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Node& node = nodes[idx];
+		const Box& box = boxes[idx];
+		Point center = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+
+		uint8_t flag = CUT_NONE;
+		if (reachesSizeInCell(box, center, t2, cell_min, cell_max))
+		{
+			if (node.count_leafs != 0)
+				flag = CUT_LEAFS;
+		}
+		else if (node.parent != -1 && reachesSizeInCell(boxes[node.parent], center, t2, cell_min, cell_max))
+		{
+			if (node.depth != 0 && node.count_merged != 0)
+				flag = CUT_LEAFS_MERGED;
+			else if (node.count_leafs != 0)
+				flag = CUT_LEAFS;
+		}
+		flags[idx] = flag;
+	}
+
+	entry.runs.clear();
+	int prev_end = 0;
+	for (int idx = 0; idx < N; )
+	{
+		uint8_t flag = flags[idx];
+		if (flag == CUT_NONE)
+		{
+			idx++;
+			continue;
+		}
+
+		int begin = idx;
+		while (idx < N && flags[idx] == flag)
+			idx++;
+
+		putVarint(entry.runs, begin - prev_end);
+		putVarint(entry.runs, ((idx - begin) << 1) | (flag == CUT_LEAFS_MERGED));
+		prev_end = idx;
+	}
+	entry.runs.shrink_to_fit();
+}
+
+void CutCache::evict()
+{
+	while (used_bytes > max_bytes && entries.size() > 1)
+	{
+		Entry& last = entries.back();
+		used_bytes -= last.runs.size();
+		lookup.erase(last.key);
+		entries.pop_back();
+		num_evictions++;
+	}
+}
+
+int CutCache::expandToSize(
+	float target_size,
+	Point viewpoint,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_for_render_indices)
+{
+	Key key;
+	key.x = (int)std::floor(viewpoint[0] / cell_size);
+	key.y = (int)std::floor(viewpoint[1] / cell_size);
+	key.z = (int)std::floor(viewpoint[2] / cell_size);
+	key.target_size = target_size;
+
+	auto it = lookup.find(key);
+	if (it != lookup.end())
+	{
+		num_hits++;
+		entries.splice(entries.begin(), entries, it->second);
+	}
+	else
+	{
+		num_misses++;
+		entries.emplace_front();
+		entries.front().key = key;
+		computeCut(key, entries.front());
+		lookup[key] = entries.begin();
+		used_bytes += entries.front().runs.size();
+		evict();
+	}
+
+	const Entry& entry = entries.front();
+	const uint8_t* in = entry.runs.data();
+	const uint8_t* end = in + entry.runs.size();
+
+	cut.clear();
+	counts.clear();
+	int idx = 0;
+	while (in < end)
+	{
+		idx += getVarint(in);
+		uint32_t run = getVarint(in);
+		bool with_merged = run & 1;
+		for (int run_end = idx + (run >> 1); idx < run_end; idx++)
+		{
+			cut.push_back(idx);
+			counts.push_back(nodes[idx].count_leafs + (with_merged ? nodes[idx].count_merged : 0));
+		}
+	}
+
+	return Traversal::putRenderIndices(nodes, (int)cut.size(), cut.data(), counts.data(), render_indices, parent_indices, nodes_for_render_indices);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include "common.h"
+
+// Cache of cuts for repeated viewpoints. Camera positions are quantized to a
+// grid of cubic cells, each (cell, target size) pair stores one cut that is
+// conservative for the whole cell: a node counts as reaching the target when it
+// does so for any viewpoint inside the cell, so the cached cut is at least as
+// fine as the one of expandToSize anywhere in the cell.
+//
+// Cuts are stored as runs of consecutive node ids (siblings are allocated next
+// to each other), gap and length are varint encoded. Least recently used cuts
+// are evicted once the encoded size exceeds max_bytes.
+class CutCache
+{
+public:
+	CutCache(int N, Node* nodes, Box* boxes, float cell_size, size_t max_bytes);
+
+	// Outputs in the layout of Traversal::expandToSize, ordered by node id.
+	// The cut is the conservative one of the viewpoint's cell, so it may hold
+	// more Gaussians than expandToSize would return for the viewpoint itself.
+	// It never holds more than the total Gaussian count of the hierarchy,
+	// which is the size the output buffers must have.
+	int expandToSize(
+		float target_size,
+		Point viewpoint,
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr);
+
+	void clear();
+
+	size_t hits() const { return num_hits; }
+	size_t misses() const { return num_misses; }
+	size_t evictions() const { return num_evictions; }
+	size_t memoryUsed() const { return used_bytes; }
+	size_t size() const { return entries.size(); }
+
+private:
+
+	struct Key
+	{
+		int x, y, z;
+		float target_size;
+
+		bool operator==(const Key& other) const
+		{
+			return x == other.x && y == other.y && z == other.z && target_size == other.target_size;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		Key key;
+		std::vector<uint8_t> runs;
+	};
+
+	void computeCut(const Key& key, Entry& entry);
+	void evict();
+
+	int N;
+	Node* nodes;
+	Box* boxes;
+	float cell_size;
+	size_t max_bytes;
+
+	std::list<Entry> entries;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+	size_t used_bytes = 0;
+
+	size_t num_hits = 0;
+	size_t num_misses = 0;
+	size_t num_evictions = 0;
+
+	std::vector<uint8_t> flags;
+	std::vector<int> cut;
+	std::vector<int> counts;
+};
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "cut_delta.h"
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool getVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (in == end)
+			return false;
+		uint8_t byte = *in++;
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static uint32_t zigzag(int value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int unzigzag(uint32_t value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static bool sameEntry(const CutEntry& a, const CutEntry& b)
+{
+	return a.start == b.start && a.count == b.count && a.parent_start == b.parent_start;
+}
+
+// Node ids are sent as gaps to the previous id, Gaussian starts as the signed
+// difference to the previous start and parent starts relative to their child
+void CutDelta::serialize(std::vector<uint8_t>& out) const
+{
+	out.clear();
+	putVarint(out, frame);
+	out.push_back(resync ? 1 : 0);
+
+	putVarint(out, (uint32_t)removed.size());
+	int prev = 0;
+	for (int node_id : removed)
+	{
+		putVarint(out, node_id - prev);
+		prev = node_id;
+	}
+
+	putVarint(out, (uint32_t)added.size());
+	prev = 0;
+	int prev_start = 0;
+	for (const CutEntry& entry : added)
+	{
+		putVarint(out, entry.node_id - prev);
+		putVarint(out, zigzag(entry.start - prev_start));
+		putVarint(out, entry.count);
+		putVarint(out, zigzag(entry.start - entry.parent_start));
+		prev = entry.node_id;
+		prev_start = entry.start;
+	}
+}
+
+bool CutDelta::deserialize(const uint8_t* data, size_t size)
+{
+	const uint8_t* in = data;
+	const uint8_t* end = data + size;
+	uint32_t value;
+
+	if (!getVarint(in, end, frame) || in == end)
+		return false;
+	resync = *in++ != 0;
+
+	if (!getVarint(in, end, value))
+		return false;
+	removed.resize(value);
+	int prev = 0;
+	for (int& node_id : removed)
+	{
+		if (!getVarint(in, end, value))
+			return false;
+		node_id = prev + (int)value;
+		prev = node_id;
+	}
+
+	if (!getVarint(in, end, value))
+		return false;
+	added.resize(value);
+	prev = 0;
+	int prev_start = 0;
+	for (CutEntry& entry : added)
+	{
+		uint32_t gap, start, count, parent;
+		if (!getVarint(in, end, gap) || !getVarint(in, end, start) || !getVarint(in, end, count) || !getVarint(in, end, parent))
+			return false;
+		entry.node_id = prev + (int)gap;
+		entry.start = prev_start + unzigzag(start);
+		entry.count = (int)count;
+		entry.parent_start = entry.start - unzigzag(parent);
+		prev = entry.node_id;
+		prev_start = entry.start;
+	}
+	return true;
+}
+
+void CutDeltaEncoder::encode(
+	int count,
+	const int* render_indices,
+	const int* parent_indices,
+	const int* nodes_for_render_indices,
+	CutDelta& delta)
+{
+	// Consecutive render indices of the same node form one entry
+	current.clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (i == 0 || nodes_for_render_indices[i] != nodes_for_render_indices[i - 1])
+			current.push_back({ nodes_for_render_indices[i], render_indices[i], 0, parent_indices[i] });
+		current.back().count++;
+	}
+
+	frame++;
+	delta.frame = frame;
+	delta.resync = force_resync;
+	delta.removed.clear();
+	delta.added.clear();
+
+	if (force_resync)
+	{
+		delta.added = current;
+		force_resync = false;
+	}
+	else
+	{
+		size_t a = 0, b = 0;
+		while (a < previous.size() || b < current.size())
+		{
+			if (b == current.size() || (a < previous.size() && previous[a].node_id < current[b].node_id))
+			{
+				delta.removed.push_back(previous[a++].node_id);
+			}
+			else if (a == previous.size() || current[b].node_id < previous[a].node_id)
+			{
+				delta.added.push_back(current[b++]);
+			}
+			else
+			{
+				if (!sameEntry(previous[a], current[b]))
+				{
+					delta.removed.push_back(previous[a].node_id);
+					delta.added.push_back(current[b]);
+				}
+				a++;
+				b++;
+			}
+		}
+	}
+
+	previous.swap(current);
+}
+
+bool CutDeltaDecoder::apply(const CutDelta& delta)
+{
+	if (delta.resync)
+	{
+		cut = delta.added;
+	}
+	else
+	{
+		if (!synced || delta.frame != frame + 1)
+			return false;
+
+		// Removals are applied before additions, a changed node appears in both
+		merged.clear();
+		size_t r = 0, a = 0;
+		for (const CutEntry& entry : cut)
+		{
+			while (a < delta.added.size() && delta.added[a].node_id < entry.node_id)
+				merged.push_back(delta.added[a++]);
+			while (r < delta.removed.size() && delta.removed[r] < entry.node_id)
+				r++;
+			if (r < delta.removed.size() && delta.removed[r] == entry.node_id)
+				continue;
+			merged.push_back(entry);
+		}
+		while (a < delta.added.size())
+			merged.push_back(delta.added[a++]);
+		cut.swap(merged);
+	}
+
+	frame = delta.frame;
+	synced = true;
+	num_gaussians = 0;
+	for (const CutEntry& entry : cut)
+		num_gaussians += entry.count;
+	return true;
+}
+
+int CutDeltaDecoder::getRenderIndices(
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_for_render_indices) const
+{
+	int offset = 0;
+	for (const CutEntry& entry : cut)
+	{
+		for (int i = 0; i < entry.count; i++)
+		{
+			render_indices[offset + i] = entry.start + i;
+			if (parent_indices)
+				parent_indices[offset + i] = entry.parent_start;
+			if (nodes_for_render_indices)
+				nodes_for_render_indices[offset + i] = entry.node_id;
+		}
+		offset += entry.count;
+	}
+	return offset;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// One node of a cut with the range of Gaussians it renders
+struct CutEntry
+{
+	int node_id;
+	int start;
+	int count;
+	int parent_start;
+};
+
+// Changes between two consecutive cuts. Removed and added node ids are sorted.
+// A resync delta carries the whole cut and replaces the client state.
+struct CutDelta
+{
+	uint32_t frame = 0;
+	bool resync = false;
+	std::vector<int> removed;
+	std::vector<CutEntry> added;
+
+	void serialize(std::vector<uint8_t>& out) const;
+	// Returns false if the buffer is truncated
+	bool deserialize(const uint8_t* data, size_t size);
+};
+
+// Server side. Keeps the cut that was last sent and turns the output of any of
+// the CPU traversals (render_indices, parent_indices, nodes_for_render_indices)
+// into the delta against it.
+class CutDeltaEncoder
+{
+public:
+	void encode(
+		int count,
+		const int* render_indices,
+		const int* parent_indices,
+		const int* nodes_for_render_indices,
+		CutDelta& delta);
+
+	// Makes the next encode() send the full cut, e.g. after a client reconnects
+	void requestResync() { force_resync = true; }
+
+private:
+	std::vector<CutEntry> previous;
+	std::vector<CutEntry> current;
+	uint32_t frame = 0;
+	bool force_resync = true;
+};
+
+// Client side. Rebuilds the render indices from the deltas it receives.
+class CutDeltaDecoder
+{
+public:
+	// Returns false if the delta does not follow the last applied frame. The
+	// state is left untouched and the client has to ask for a resync.
+	bool apply(const CutDelta& delta);
+
+	// Same layout as Traversal::expandToSize, ordered by node id
+	int getRenderIndices(
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr) const;
+
+	int numGaussians() const { return num_gaussians; }
+
+private:
+	std::vector<CutEntry> cut;
+	std::vector<CutEntry> merged;
+	uint32_t frame = 0;
+	bool synced = false;
+	int num_gaussians = 0;
+};
@@ -17,5 +17,9 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   m.def("write_hierarchy", &WriteHierarchy);
   m.def("expand_to_target", &ExpandToTarget);
   m.def("expand_to_size", &ExpandToSize);
+  m.def("expand_to_size_frustum", &ExpandToSizeFrustum);
+  m.def("expand_to_size_foveated", &ExpandToSizeFoveated);
+  m.def("expand_to_size_multi_view", &ExpandToSizeMultiView);
+  m.def("expand_to_budget", &ExpandToBudget);
   m.def("get_interpolation_weights", &GetTsIndexed);
 }
\ No newline at end of file
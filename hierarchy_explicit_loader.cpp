@@ -18,24 +18,202 @@
 #include <iostream>
 #include <fstream>
 #include "half.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
-float getWeight(Eigen::Vector3f& pos, int chunk_id,
-	std::vector<Eigen::Vector3f>& chunk_centers)
+#define KD_LEAF 8
+#define WEIGHT_FALLOFF 0.05f
+
+// Kd-tree over the chunk centers. Leaves hold up to KD_LEAF centers in
+// separate coordinate arrays, so the distances of a leaf vectorize.
+class ChunkCenterIndex
 {
-	float dist_to_current_center = (pos - chunk_centers[chunk_id]).norm();
-	float min_dist_to_other_center = 1e12f;
-	for (int other_chunk_id(0); other_chunk_id < chunk_centers.size(); other_chunk_id++)
+public:
+	ChunkCenterIndex(const std::vector<Eigen::Vector3f>& centers)
+	{
+		int C = (int)centers.size();
+		ids.resize(C);
+		for (int i = 0; i < C; i++)
+			ids[i] = i;
+		if (C > 0)
+			build(centers, 0, C);
+
+		slot.resize(C);
+		xs.resize(C);
+		ys.resize(C);
+		zs.resize(C);
+		for (int i = 0; i < C; i++)
+		{
+			slot[ids[i]] = i;
+			xs[i] = centers[ids[i]].x();
+			ys[i] = centers[ids[i]].y();
+			zs[i] = centers[ids[i]].z();
+		}
+	}
+
+	// Closest center to pos other than exclude, -1 if there is none
+	int nearestOther(const Eigen::Vector3f& pos, int exclude) const
+	{
+		return search(exclude,
+			[&](const Eigen::Vector3f& lo, const Eigen::Vector3f& hi) {
+				return (lo - pos).cwiseMax(pos - hi).cwiseMax(0.0f).squaredNorm();
+			},
+			[&](int begin, int end, float* d2) {
+				float x = pos.x(), y = pos.y(), z = pos.z();
+#pragma omp simd
+				for (int i = begin; i < end; i++)
+				{
+					float dx = xs[i] - x, dy = ys[i] - y, dz = zs[i] - z;
+					d2[i - begin] = dx * dx + dy * dy + dz * dz;
+				}
+			});
+	}
+
+	// Over the centers other than exclude: the smallest distance from the box
+	// to a center, and the smallest distance from a center to the farthest
+	// point of the box
+	void boxDistances(const Eigen::Vector3f& lo, const Eigen::Vector3f& hi, int exclude, float& min_near, float& min_far) const
+	{
+		Eigen::Vector3f mid = (lo + hi) / 2;
+		Eigen::Vector3f half = (hi - lo) / 2;
+
+		int near_id = search(exclude,
+			[&](const Eigen::Vector3f& rlo, const Eigen::Vector3f& rhi) {
+				return (rlo - hi).cwiseMax(lo - rhi).cwiseMax(0.0f).squaredNorm();
+			},
+			[&](int begin, int end, float* d2) {
+				for (int i = begin; i < end; i++)
+					d2[i - begin] = nearSquared(lo, hi, i);
+			});
+
+		// The farthest box point is at least half the diagonal away, plus the distance to the box center
+		int far_id = search(exclude,
+			[&](const Eigen::Vector3f& rlo, const Eigen::Vector3f& rhi) {
+				float d = (rlo - mid).cwiseMax(mid - rhi).cwiseMax(0.0f).norm();
+				return d * d + half.squaredNorm();
+			},
+			[&](int begin, int end, float* d2) {
+				for (int i = begin; i < end; i++)
+					d2[i - begin] = farSquared(lo, hi, i);
+			});
+
+		min_near = near_id == -1 ? 1e12f : std::sqrt(nearSquared(lo, hi, slot[near_id]));
+		min_far = far_id == -1 ? 1e12f : std::sqrt(farSquared(lo, hi, slot[far_id]));
+	}
+
+private:
+	struct KdNode
+	{
+		Eigen::Vector3f lo, hi;
+		int begin, end;
+		int left = -1, right = -1;
+	};
+
+	int build(const std::vector<Eigen::Vector3f>& centers, int begin, int end)
 	{
-		if (other_chunk_id != chunk_id)
+		KdNode node;
+		node.lo = node.hi = centers[ids[begin]];
+		for (int i = begin; i < end; i++)
 		{
-			float dist_to_other_center = (pos - chunk_centers[other_chunk_id]).norm();
-			if (min_dist_to_other_center > dist_to_other_center)
+			node.lo = node.lo.cwiseMin(centers[ids[i]]);
+			node.hi = node.hi.cwiseMax(centers[ids[i]]);
+		}
+		node.begin = begin;
+		node.end = end;
+
+		int current = (int)kdnodes.size();
+		kdnodes.push_back(node);
+		if (end - begin > KD_LEAF)
+		{
+			int axis;
+			(node.hi - node.lo).maxCoeff(&axis);
+			int mid = (begin + end) / 2;
+			std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+				[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+			int left = build(centers, begin, mid);
+			int right = build(centers, mid, end);
+			kdnodes[current].left = left;
+			kdnodes[current].right = right;
+		}
+		return current;
+	}
+
+	float nearSquared(const Eigen::Vector3f& lo, const Eigen::Vector3f& hi, int i) const
+	{
+		Eigen::Vector3f c(xs[i], ys[i], zs[i]);
+		return (lo - c).cwiseMax(c - hi).cwiseMax(0.0f).squaredNorm();
+	}
+
+	float farSquared(const Eigen::Vector3f& lo, const Eigen::Vector3f& hi, int i) const
+	{
+		Eigen::Vector3f c(xs[i], ys[i], zs[i]);
+		return (c - lo).cwiseAbs().cwiseMax((hi - c).cwiseAbs()).squaredNorm();
+	}
+
+	// Best first search, bound gives a lower bound of the squared metric over a
+	// kd-node's region and leaf the squared metric of the centers in a leaf.
+	// Returns the chunk id of the best center.
+	template<typename Bound, typename Leaf>
+	int search(int exclude, Bound bound, Leaf leaf) const
+	{
+		if (kdnodes.empty())
+			return -1;
+
+		float best = FLT_MAX;
+		int best_id = -1;
+		float d2[KD_LEAF];
+
+		std::vector<std::pair<float, int>> stack;
+		stack.push_back(std::make_pair(bound(kdnodes[0].lo, kdnodes[0].hi), 0));
+		while (!stack.empty())
+		{
+			auto entry = stack.back();
+			stack.pop_back();
+			if (entry.first >= best)
+				continue;
+
+			const KdNode& node = kdnodes[entry.second];
+			if (node.left == -1)
+			{
+				leaf(node.begin, node.end, d2);
+				for (int i = node.begin; i < node.end; i++)
+				{
+					if (ids[i] != exclude && d2[i - node.begin] < best)
+					{
+						best = d2[i - node.begin];
+						best_id = ids[i];
+					}
+				}
+				continue;
+			}
+
+			// Visit the closer child first
+			float dl = bound(kdnodes[node.left].lo, kdnodes[node.left].hi);
+			float dr = bound(kdnodes[node.right].lo, kdnodes[node.right].hi);
+			if (dl < dr)
+			{
+				stack.push_back(std::make_pair(dr, node.right));
+				stack.push_back(std::make_pair(dl, node.left));
+			}
+			else
 			{
-				min_dist_to_other_center = dist_to_other_center;
+				stack.push_back(std::make_pair(dl, node.left));
+				stack.push_back(std::make_pair(dr, node.right));
 			}
 		}
+		return best_id;
 	}
-	float falloff = 0.05f;
+
+	std::vector<KdNode> kdnodes;
+	std::vector<int> ids; // chunk ids in leaf order
+	std::vector<int> slot; // leaf order position of each chunk id
+	std::vector<float> xs, ys, zs;
+};
+
+float HierarchyExplicitLoader::getWeight(float dist_to_current_center, float min_dist_to_other_center)
+{
+	float falloff = WEIGHT_FALLOFF;
 	if (dist_to_current_center <= (1.f - falloff) * min_dist_to_other_center)
 	{
 		return 1.f;
@@ -52,10 +230,39 @@ float getWeight(Eigen::Vector3f& pos, int chunk_id,
 	}
 }
 
+float getWeight(const Eigen::Vector3f& pos, int chunk_id,
+	const std::vector<Eigen::Vector3f>& chunk_centers, const ChunkCenterIndex& index)
+{
+	float dist_to_current_center = (pos - chunk_centers[chunk_id]).norm();
+	int other = index.nearestOther(pos, chunk_id);
+	float min_dist_to_other_center = other == -1 ? 1e12f : (pos - chunk_centers[other]).norm();
+	return HierarchyExplicitLoader::getWeight(dist_to_current_center, min_dist_to_other_center);
+}
+
+// Classifies a box whose points all get weight one (inside the chunk's
+// Voronoi cell shrunk by the falloff) or zero (outside the cell grown by the
+// falloff). The margins keep the float comparisons of getWeight on the same side.
+HierarchyExplicitLoader::WeightClass classifyBox(const Eigen::Vector3f& lo, const Eigen::Vector3f& hi, int chunk_id,
+	const std::vector<Eigen::Vector3f>& chunk_centers, const ChunkCenterIndex& index)
+{
+	const Eigen::Vector3f& c = chunk_centers[chunk_id];
+	float near_current = (lo - c).cwiseMax(c - hi).cwiseMax(0.0f).norm();
+	float far_current = (c - lo).cwiseAbs().cwiseMax((hi - c).cwiseAbs()).norm();
+
+	float min_near, min_far;
+	index.boxDistances(lo, hi, chunk_id, min_near, min_far);
+
+	if (far_current * 1.0001f <= (1.f - WEIGHT_FALLOFF) * min_near * 0.9999f)
+		return HierarchyExplicitLoader::WEIGHT_ONE;
+	if (near_current * 0.9999f > (1.f + WEIGHT_FALLOFF) * min_far * 1.0001f)
+		return HierarchyExplicitLoader::WEIGHT_ZERO;
+	return HierarchyExplicitLoader::WEIGHT_PARTIAL;
+}
+
 std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	std::vector<Gaussian>& gaussians,
-	int chunk_id,
-	std::vector<Eigen::Vector3f>& chunk_centers,
+	const std::vector<float>& weights,
+	const std::vector<char>& classes,
 	Node& node,
 	int node_id,
 	std::vector<Eigen::Vector3f>& pos,
@@ -66,6 +273,10 @@ std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	std::vector<Node>& nodes,
 	std::vector<Box>& boxes)
 {
+	// Nothing below has a positive weight
+	if (classes[node_id] == HierarchyExplicitLoader::WEIGHT_ZERO)
+		return std::vector<ExplicitTreeNode*>();
+
 	expliciteNode->depth = node.depth;
 	expliciteNode->bounds = boxes[node_id];
 	int n_valid_gaussians = 0;
@@ -73,7 +284,7 @@ std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	{
 		for (int n(0); n < node.count_merged; n++)
 		{
-			float weigth = getWeight(pos[node.start + n], chunk_id, chunk_centers);
+			float weigth = weights[node.start + n];
 			if (weigth > 0.f)
 			{
 				n_valid_gaussians++;
@@ -92,7 +303,7 @@ std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	{
 		for (int n(0); n < node.count_leafs; n++)
 		{
-			float weigth = getWeight(pos[node.start + n], chunk_id, chunk_centers);
+			float weigth = weights[node.start + n];
 			if (weigth > 0.f)
 			{
 				n_valid_gaussians++;
@@ -113,7 +324,7 @@ std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	for (int i = 0; i < node.count_children; i++)
 	{
 		ExplicitTreeNode* newNode = new ExplicitTreeNode;
-		std::vector<ExplicitTreeNode*> newChildren = buildTreeRec(newNode, gaussians, chunk_id, chunk_centers,
+		std::vector<ExplicitTreeNode*> newChildren = buildTreeRec(newNode, gaussians, weights, classes,
 			nodes[node.start_children + i], node.start_children + i,
 			pos, shs, alphas, scales, rot, nodes, boxes
 		);
@@ -131,6 +342,61 @@ std::vector<ExplicitTreeNode*> buildTreeRec(ExplicitTreeNode* expliciteNode,
 	}
 }
 
+void HierarchyExplicitLoader::computeWeights(
+	int chunk_id,
+	const std::vector<Eigen::Vector3f>& chunk_centers,
+	const std::vector<Eigen::Vector3f>& pos,
+	const std::vector<Node>& nodes,
+	std::vector<float>& weights,
+	std::vector<char>& classes)
+{
+	int N = (int)nodes.size();
+	auto used = [&](const Node& node) { return node.depth > 0 ? node.count_merged : node.count_leafs; };
+
+	// Bounds of the positions each subtree weighs, children have higher ids than their parent
+	std::vector<Eigen::Vector3f> lo(N, Eigen::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX)), hi(N, Eigen::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	for (int node_id = N - 1; node_id >= 0; node_id--)
+	{
+		const Node& node = nodes[node_id];
+		for (int n = 0; n < used(node); n++)
+		{
+			lo[node_id] = lo[node_id].cwiseMin(pos[node.start + n]);
+			hi[node_id] = hi[node_id].cwiseMax(pos[node.start + n]);
+		}
+		if (node.parent != -1)
+		{
+			lo[node.parent] = lo[node.parent].cwiseMin(lo[node_id]);
+			hi[node.parent] = hi[node.parent].cwiseMax(hi[node_id]);
+		}
+	}
+
+	// Subtrees entirely inside or outside the cell inherit their class
+	ChunkCenterIndex index(chunk_centers);
+	classes.assign(N, WEIGHT_PARTIAL);
+	for (int node_id = 0; node_id < N; node_id++)
+	{
+		int parent = nodes[node_id].parent;
+		if (parent != -1 && classes[parent] != WEIGHT_PARTIAL)
+			classes[node_id] = classes[parent];
+		else if (lo[node_id].x() <= hi[node_id].x())
+			classes[node_id] = classifyBox(lo[node_id], hi[node_id], chunk_id, chunk_centers, index);
+	}
+
+	weights.assign(pos.size(), 0.f);
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int node_id = 0; node_id < N; node_id++)
+	{
+		const Node& node = nodes[node_id];
+		for (int n = 0; n < used(node); n++)
+		{
+			if (classes[node_id] == WEIGHT_PARTIAL)
+				weights[node.start + n] = ::getWeight(pos[node.start + n], chunk_id, chunk_centers, index);
+			else
+				weights[node.start + n] = classes[node_id] == WEIGHT_ONE ? 1.f : 0.f;
+		}
+	}
+}
+
 void HierarchyExplicitLoader::loadExplicit(
 	const char* filename, std::vector<Gaussian>& gaussians, ExplicitTreeNode* root,
 	int chunk_id, std::vector<Eigen::Vector3f>& chunk_centers)
@@ -145,5 +411,10 @@ void HierarchyExplicitLoader::loadExplicit(
 	HierarchyLoader::load(filename, pos, shs, alphas, scales, rot, nodes, boxes);
 
 	pos[0] = chunk_centers[chunk_id];
-	buildTreeRec(root, gaussians, chunk_id, chunk_centers, nodes[0], 0, pos, shs, alphas, scales, rot, nodes, boxes);
+
+	std::vector<float> weights;
+	std::vector<char> classes;
+	computeWeights(chunk_id, chunk_centers, pos, nodes, weights, classes);
+
+	buildTreeRec(root, gaussians, weights, classes, nodes[0], 0, pos, shs, alphas, scales, rot, nodes, boxes);
 }
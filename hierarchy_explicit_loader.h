@@ -21,6 +21,29 @@ class HierarchyExplicitLoader
 {
 public:
 
+	enum WeightClass : char
+	{
+		WEIGHT_PARTIAL,
+		WEIGHT_ONE, // the whole subtree has weight one
+		WEIGHT_ZERO // the whole subtree has weight zero
+	};
+
+	// Blending weights of a chunk against the other chunk centers for every
+	// Gaussian a node weighs (merged ones of interior nodes, leaves of leaf
+	// nodes), zero for the rest, and the WeightClass of every node
+	static void computeWeights(
+		int chunk_id,
+		const std::vector<Eigen::Vector3f>& chunk_centers,
+		const std::vector<Eigen::Vector3f>& pos,
+		const std::vector<Node>& nodes,
+		std::vector<float>& weights,
+		std::vector<char>& classes);
+
+	// Weight of a Gaussian at dist_to_current_center from its chunk's center,
+	// given the distance to the closest other center: one up to 1 - falloff
+	// times that distance, zero beyond 1 + falloff times, linear in between
+	static float getWeight(float dist_to_current_center, float min_dist_to_other_center);
+
 	static void loadExplicit(const char* filename,
 		std::vector<Gaussian>& gaussian, ExplicitTreeNode* root,
 		int chunk_id, std::vector<Eigen::Vector3f>& chunk_centers);
@@ -0,0 +1,633 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "hierarchy_splicer.h"
+#include "hierarchy_explicit_loader.h"
+#include "ClusterMerger.h"
+#include "half.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <cfloat>
+#include <cstdint>
+
+struct HalfBox3
+{
+	half_float::half minn[4];
+	half_float::half maxx[4];
+};
+
+// One chunk in the encoding of a compressed hierarchy file
+struct SplicedChunk
+{
+	std::vector<Eigen::Vector3f> pos;
+	std::vector<half_float::half> rot; // 4 per Gaussian
+	std::vector<half_float::half> scale; // 3 per Gaussian, log scales
+	std::vector<half_float::half> opacity;
+	std::vector<float> float_opacity; // uncompressed input, rounded after weighting
+	std::vector<half_float::half> shs; // 48 per Gaussian
+	std::vector<Node> nodes;
+	std::vector<HalfBox3> boxes;
+
+	Gaussian root_gaussian;
+
+	int numGaussians() const { return (int)pos.size(); }
+};
+
+static void readChunk(const std::string& filename, SplicedChunk& chunk)
+{
+	std::ifstream infile(filename, std::ios_base::binary);
+	if (!infile.good())
+		throw std::runtime_error("File not found!");
+
+	int P;
+	infile.read((char*)&P, sizeof(int));
+
+	if (P >= 0)
+	{
+		// Uncompressed chunks are brought to the output encoding
+		std::vector<Eigen::Vector4f> rot(P);
+		std::vector<Eigen::Vector3f> scales(P);
+		std::vector<float> alphas(P);
+		std::vector<SHs> shs(P);
+
+		chunk.pos.resize(P);
+		infile.read((char*)chunk.pos.data(), P * sizeof(Eigen::Vector3f));
+		infile.read((char*)rot.data(), P * sizeof(Eigen::Vector4f));
+		infile.read((char*)scales.data(), P * sizeof(Eigen::Vector3f));
+		infile.read((char*)alphas.data(), P * sizeof(float));
+		infile.read((char*)shs.data(), P * sizeof(SHs));
+		chunk.float_opacity.swap(alphas);
+
+		chunk.rot.resize(P * (size_t)4);
+		chunk.scale.resize(P * (size_t)3);
+		chunk.shs.resize(P * (size_t)48);
+		for (size_t i = 0; i < (size_t)P; i++)
+		{
+			for (size_t j = 0; j < 4; j++)
+				chunk.rot[i * 4 + j] = rot[i][j];
+			for (size_t j = 0; j < 3; j++)
+				chunk.scale[i * 3 + j] = scales[i][j];
+			for (size_t j = 0; j < 48; j++)
+				chunk.shs[i * 48 + j] = shs[i][j];
+		}
+
+		int N;
+		infile.read((char*)&N, sizeof(int));
+		std::vector<Box> boxes(N);
+		chunk.nodes.resize(N);
+		infile.read((char*)chunk.nodes.data(), N * sizeof(Node));
+		infile.read((char*)boxes.data(), N * sizeof(Box));
+
+		chunk.boxes.resize(N);
+		for (int i = 0; i < N; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				chunk.boxes[i].minn[j] = boxes[i].minn[j];
+				chunk.boxes[i].maxx[j] = boxes[i].maxx[j];
+			}
+		}
+	}
+	else
+	{
+		size_t allP = -P;
+
+		chunk.pos.resize(allP);
+		chunk.rot.resize(allP * 4);
+		chunk.scale.resize(allP * 3);
+		chunk.opacity.resize(allP);
+		chunk.shs.resize(allP * 48);
+		infile.read((char*)chunk.pos.data(), allP * sizeof(Eigen::Vector3f));
+		infile.read((char*)chunk.rot.data(), allP * 4 * sizeof(half_float::half));
+		infile.read((char*)chunk.scale.data(), allP * 3 * sizeof(half_float::half));
+		infile.read((char*)chunk.opacity.data(), allP * sizeof(half_float::half));
+		infile.read((char*)chunk.shs.data(), allP * 48 * sizeof(half_float::half));
+
+		int N;
+		infile.read((char*)&N, sizeof(int));
+		size_t allN = N;
+
+		std::vector<HalfNode> half_nodes(allN);
+		infile.read((char*)half_nodes.data(), allN * sizeof(HalfNode));
+		chunk.nodes.resize(allN);
+		for (size_t i = 0; i < allN; i++)
+		{
+			chunk.nodes[i].parent = half_nodes[i].parent;
+			chunk.nodes[i].start = half_nodes[i].start;
+			chunk.nodes[i].start_children = half_nodes[i].start_children;
+			chunk.nodes[i].depth = half_nodes[i].dccc[0];
+			chunk.nodes[i].count_children = half_nodes[i].dccc[1];
+			chunk.nodes[i].count_leafs = half_nodes[i].dccc[2];
+			chunk.nodes[i].count_merged = half_nodes[i].dccc[3];
+		}
+
+		chunk.boxes.resize(allN);
+		infile.read((char*)chunk.boxes.data(), allN * sizeof(HalfBox3));
+	}
+}
+
+// Copies the subtree below root_id in the order populateRec writes it: a
+// node writes its Gaussians, appends its children block, then visits the
+// children in order. With weights, opacities are scaled and Gaussians of
+// zero weight dropped, nodes left without any hand their children up.
+static void spliceSubtree(const SplicedChunk& src, int root_id, const std::vector<float>* weights, SplicedChunk& out)
+{
+	const std::vector<Node>& nodes = src.nodes;
+	auto used = [&](const Node& node) { return node.depth > 0 ? node.count_merged : node.count_leafs; };
+	auto weight = [&](int g) { return weights ? (*weights)[g] : 1.f; };
+
+	// The root always stays, like the chunk root of the explicit loader
+	auto kept = [&](int node_id) {
+		if (node_id == root_id)
+			return true;
+		const Node& node = nodes[node_id];
+		for (int n = 0; n < used(node); n++)
+			if (weight(node.start + n) > 0.f)
+				return true;
+		return false;
+	};
+
+	// Kept children of a node, looking through dropped nodes
+	std::vector<int> stack;
+	auto keptChildren = [&](int node_id, std::vector<int>& children) {
+		children.clear();
+		const Node& node = nodes[node_id];
+		for (int i = node.count_children - 1; i >= 0; i--)
+			stack.push_back(node.start_children + i);
+		while (!stack.empty())
+		{
+			int child = stack.back();
+			stack.pop_back();
+			if (kept(child))
+			{
+				children.push_back(child);
+				continue;
+			}
+			const Node& dropped = nodes[child];
+			for (int i = dropped.count_children - 1; i >= 0; i--)
+				stack.push_back(dropped.start_children + i);
+		}
+	};
+
+	out = SplicedChunk();
+	out.nodes.resize(1);
+	out.boxes.resize(1);
+
+	std::vector<std::pair<int, int>> visit; // source id, output id
+	visit.push_back(std::make_pair(root_id, 0));
+	std::vector<int> children;
+	while (!visit.empty())
+	{
+		int src_id = visit.back().first;
+		int dst_id = visit.back().second;
+		visit.pop_back();
+
+		const Node& node = nodes[src_id];
+		Node dst;
+		dst.parent = out.nodes[dst_id].parent;
+		dst.depth = node.depth;
+		dst.start = out.numGaussians();
+
+		for (int n = 0; n < used(node); n++)
+		{
+			int g = node.start + n;
+			float w = weight(g);
+			if (w <= 0.f)
+				continue;
+
+			float opacity = (src.opacity.empty() ? src.float_opacity[g] : (float)src.opacity[g]) * w;
+			if (dst_id == 0 && out.numGaussians() == dst.start)
+			{
+				Gaussian& rg = out.root_gaussian;
+				rg.position = src.pos[g];
+				for (int j = 0; j < 4; j++)
+					rg.rotation[j] = src.rot[4 * (size_t)g + j];
+				for (int j = 0; j < 3; j++)
+					rg.scale[j] = std::exp((float)src.scale[3 * (size_t)g + j]);
+				rg.opacity = opacity;
+				for (int j = 0; j < 48; j++)
+					rg.shs[j] = src.shs[48 * (size_t)g + j];
+				computeCovariance(rg.scale, rg.rotation, rg.covariance);
+			}
+
+			out.pos.push_back(src.pos[g]);
+			out.rot.insert(out.rot.end(), src.rot.begin() + 4 * (size_t)g, src.rot.begin() + 4 * (size_t)g + 4);
+			out.scale.insert(out.scale.end(), src.scale.begin() + 3 * (size_t)g, src.scale.begin() + 3 * (size_t)g + 3);
+			out.opacity.push_back(half_float::half(opacity));
+			out.shs.insert(out.shs.end(), src.shs.begin() + 48 * (size_t)g, src.shs.begin() + 48 * (size_t)g + 48);
+		}
+		int count = out.numGaussians() - dst.start;
+		dst.count_leafs = node.depth == 0 ? count : 0;
+		dst.count_merged = node.depth > 0 ? count : 0;
+
+		keptChildren(src_id, children);
+		dst.start_children = (int)out.nodes.size();
+		dst.count_children = (int)children.size();
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			Node child;
+			child.parent = dst_id;
+			out.nodes.push_back(child);
+			out.boxes.push_back(HalfBox3());
+		}
+		for (int i = (int)children.size() - 1; i >= 0; i--)
+			visit.push_back(std::make_pair(children[i], dst.start_children + i));
+
+		out.nodes[dst_id] = dst;
+		out.boxes[dst_id] = src.boxes[src_id];
+	}
+
+	if (out.nodes[0].count_merged == 0)
+		throw std::runtime_error("Chunk root has no Gaussian left");
+
+	out.pos.shrink_to_fit();
+	out.rot.shrink_to_fit();
+	out.scale.shrink_to_fit();
+	out.opacity.shrink_to_fit();
+	out.shs.shrink_to_fit();
+}
+
+// Weighs a chunk against the other chunk centers and keeps what the explicit
+// loader would keep
+static void filterChunk(SplicedChunk& chunk, int chunk_id, const std::vector<Eigen::Vector3f>& chunk_centers)
+{
+	if (chunk.nodes.empty() || chunk.nodes[0].depth == 0)
+		throw std::runtime_error("Chunk hierarchy needs an interior root");
+
+	chunk.pos[0] = chunk_centers[chunk_id];
+
+	std::vector<float> weights;
+	std::vector<char> classes;
+	HierarchyExplicitLoader::computeWeights(chunk_id, chunk_centers, chunk.pos, chunk.nodes, weights, classes);
+
+	SplicedChunk out;
+	spliceSubtree(chunk, 0, &weights, out);
+	chunk = std::move(out);
+}
+
+// Chunk roots a top-level node holds directly, more are split in two
+#define TOP_FANOUT 4
+
+// Top levels over the chunk roots, a kd-tree on the chunk centers. It only
+// depends on the centers, so a merged file can be taken apart again.
+struct TopLevel
+{
+	// Children of each top-level node, >= 0 for a top-level node and -1 - c
+	// for the root of chunk c. Children come after their parent.
+	std::vector<std::vector<int>> children;
+
+	// Node ids in the written hierarchy
+	std::vector<int> node_id; // per top-level node
+	std::vector<int> chunk_slot; // per chunk root
+	std::vector<int> parent; // per node id below top_nodes + chunks
+	std::vector<int> start_children; // per top-level node
+	std::vector<int> gaussian; // per top-level node
+
+	int numNodes() const { return (int)parent.size(); }
+};
+
+static int buildTopRec(std::vector<int>::iterator begin, std::vector<int>::iterator end,
+	const std::vector<Eigen::Vector3f>& chunk_centers, TopLevel& top)
+{
+	int top_id = (int)top.children.size();
+	top.children.push_back(std::vector<int>());
+
+	int count = (int)(end - begin);
+	if (count <= TOP_FANOUT)
+	{
+		for (auto it = begin; it != end; it++)
+			top.children[top_id].push_back(-1 - *it);
+		return top_id;
+	}
+
+	Eigen::Vector3f minn(FLT_MAX, FLT_MAX, FLT_MAX), maxx(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (auto it = begin; it != end; it++)
+	{
+		minn = minn.cwiseMin(chunk_centers[*it]);
+		maxx = maxx.cwiseMax(chunk_centers[*it]);
+	}
+	int axis;
+	(maxx - minn).maxCoeff(&axis);
+
+	auto mid = begin + count / 2;
+	std::nth_element(begin, mid, end, [&](int a, int b) {
+		float ca = chunk_centers[a][axis], cb = chunk_centers[b][axis];
+		return ca < cb || (ca == cb && a < b);
+	});
+
+	for (auto half : { std::make_pair(begin, mid), std::make_pair(mid, end) })
+	{
+		int child = buildTopRec(half.first, half.second, chunk_centers, top);
+		top.children[top_id].push_back(child);
+	}
+	return top_id;
+}
+
+static void buildTopLevel(const std::vector<Eigen::Vector3f>& chunk_centers, TopLevel& top)
+{
+	int C = (int)chunk_centers.size();
+	std::vector<int> chunk_ids(C);
+	for (int chunk_id = 0; chunk_id < C; chunk_id++)
+		chunk_ids[chunk_id] = chunk_id;
+	buildTopRec(chunk_ids.begin(), chunk_ids.end(), chunk_centers, top);
+
+	// Ids and Gaussians in populateRec order, chunk bodies are written after all of them
+	int T = (int)top.children.size();
+	top.node_id.resize(T);
+	top.start_children.resize(T);
+	top.gaussian.resize(T);
+	top.chunk_slot.resize(C);
+	top.parent.assign(1, -1);
+
+	int num_gaussians = 0;
+	std::vector<std::pair<int, int>> visit; // top-level node, node id
+	visit.push_back(std::make_pair(0, 0));
+	while (!visit.empty())
+	{
+		int top_id = visit.back().first;
+		int node_id = visit.back().second;
+		visit.pop_back();
+
+		const std::vector<int>& children = top.children[top_id];
+		top.node_id[top_id] = node_id;
+		top.gaussian[top_id] = num_gaussians++;
+		top.start_children[top_id] = top.numNodes();
+		for (int child : children)
+		{
+			if (child < 0)
+				top.chunk_slot[-1 - child] = top.numNodes();
+			top.parent.push_back(node_id);
+		}
+		for (int i = (int)children.size() - 1; i >= 0; i--)
+			if (children[i] >= 0)
+				visit.push_back(std::make_pair(children[i], top.start_children[top_id] + i));
+	}
+}
+
+// Writes the chunks below the top levels of their centers
+static void writeSpliced(const std::vector<SplicedChunk>& chunks, const std::vector<Eigen::Vector3f>& chunk_centers, const char* filename)
+{
+	int C = (int)chunks.size();
+	TopLevel top;
+	buildTopLevel(chunk_centers, top);
+	int T = (int)top.children.size();
+
+	// Moment matching bottom up, a single child is kept as it is. The root
+	// box has an infinite extent as before.
+	std::vector<Node> top_nodes(T);
+	std::vector<Box> top_boxes(T, Box(Eigen::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX), Eigen::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX)));
+	std::vector<Gaussian> top_gaussians(T);
+	for (int top_id = T - 1; top_id >= 0; top_id--)
+	{
+		Node& node = top_nodes[top_id];
+		Box& box = top_boxes[top_id];
+		float min_extent = 0, max_extent = 0;
+		std::vector<Gaussian> merged;
+		for (int child : top.children[top_id])
+		{
+			int depth;
+			Eigen::Vector4f child_minn, child_maxx;
+			if (child >= 0)
+			{
+				depth = top_nodes[child].depth;
+				child_minn = top_boxes[child].minn;
+				child_maxx = top_boxes[child].maxx;
+				merged.push_back(top_gaussians[child]);
+			}
+			else
+			{
+				const SplicedChunk& chunk = chunks[-1 - child];
+				depth = chunk.nodes[0].depth;
+				for (int j = 0; j < 4; j++)
+				{
+					child_minn[j] = chunk.boxes[0].minn[j];
+					child_maxx[j] = chunk.boxes[0].maxx[j];
+				}
+				merged.push_back(chunk.root_gaussian);
+			}
+			node.depth = std::max(node.depth, depth + 1);
+			box.minn = box.minn.cwiseMin(child_minn);
+			box.maxx = box.maxx.cwiseMax(child_maxx);
+			min_extent = std::max(min_extent, child_minn[3]);
+			max_extent = std::max(max_extent, child_maxx[3]);
+		}
+
+		Eigen::Vector4f diff = box.maxx - box.minn;
+		box.minn[3] = std::max(min_extent, std::min(std::min(diff.x(), diff.y()), diff.z()));
+		box.maxx[3] = std::max(max_extent, std::max(std::max(diff.x(), diff.y()), diff.z()));
+		top_gaussians[top_id] = merged.size() == 1 ? merged[0] : ClusterMerger::mergeGaussians(merged);
+
+		node.parent = top_id == 0 ? -1 : top.parent[top.node_id[top_id]];
+		node.start = top.gaussian[top_id];
+		node.count_leafs = 0;
+		node.count_merged = 1;
+		node.start_children = top.start_children[top_id];
+		node.count_children = (int)top.children[top_id].size();
+	}
+	top_boxes[0].minn[3] = top_boxes[0].maxx[3] = 1e9f;
+
+	// Chunk bodies follow the top levels in chunk order
+	std::vector<int> node_offsets(C), gaussian_offsets(C);
+	size_t allP = T, allN = top.numNodes();
+	for (int chunk_id = 0; chunk_id < C; chunk_id++)
+	{
+		node_offsets[chunk_id] = (int)allN;
+		gaussian_offsets[chunk_id] = (int)allP;
+		allN += chunks[chunk_id].nodes.size() - 1;
+		allP += chunks[chunk_id].numGaussians();
+	}
+	if (allP > INT32_MAX || allN > INT32_MAX)
+		throw std::runtime_error("Merged hierarchy is too large!");
+
+	auto rebase = [&](int chunk_id, int local_id) {
+		return local_id == 0 ? top.chunk_slot[chunk_id] : node_offsets[chunk_id] + local_id - 1;
+	};
+	auto toHalf = [](const Node& node) {
+		if (node.depth > 32000 || node.count_children > 32000 || node.count_leafs > 32000 || node.count_merged > 32000)
+			throw std::runtime_error("Would lose information!");
+		HalfNode half_node;
+		half_node.parent = node.parent;
+		half_node.start = node.start;
+		half_node.start_children = node.start_children;
+		half_node.dccc[0] = (short)node.depth;
+		half_node.dccc[1] = (short)node.count_children;
+		half_node.dccc[2] = (short)node.count_leafs;
+		half_node.dccc[3] = (short)node.count_merged;
+		return half_node;
+	};
+	auto rebasedNode = [&](int chunk_id, int local_id) {
+		Node node = chunks[chunk_id].nodes[local_id];
+		node.parent = local_id == 0 ? top.parent[top.chunk_slot[chunk_id]] : rebase(chunk_id, node.parent);
+		node.start += gaussian_offsets[chunk_id];
+		node.start_children = rebase(chunk_id, node.start_children);
+		return toHalf(node);
+	};
+
+	// Top-level Gaussians in the order of their start
+	std::vector<Eigen::Vector3f> top_pos(T);
+	std::vector<half_float::half> top_rot(T * 4), top_scale(T * 3), top_opacity(T), top_shs(T * 48);
+	for (int top_id = 0; top_id < T; top_id++)
+	{
+		const Gaussian& g = top_gaussians[top_id];
+		int i = top.gaussian[top_id];
+		top_pos[i] = g.position;
+		for (int j = 0; j < 4; j++)
+			top_rot[i * 4 + j] = g.rotation[j];
+		for (int j = 0; j < 3; j++)
+			top_scale[i * 3 + j] = std::log(g.scale[j]);
+		top_opacity[i] = g.opacity;
+		for (int j = 0; j < 48; j++)
+			top_shs[i * 48 + j] = g.shs[j];
+	}
+
+	std::ofstream outfile(filename, std::ios_base::binary);
+	if (!outfile.good())
+		throw std::runtime_error("File not created!");
+
+	int indi = -(int)allP;
+	outfile.write((char*)(&indi), sizeof(int));
+
+	outfile.write((char*)top_pos.data(), top_pos.size() * sizeof(Eigen::Vector3f));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)chunk.pos.data(), chunk.pos.size() * sizeof(Eigen::Vector3f));
+	outfile.write((char*)top_rot.data(), top_rot.size() * sizeof(half_float::half));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)chunk.rot.data(), chunk.rot.size() * sizeof(half_float::half));
+	outfile.write((char*)top_scale.data(), top_scale.size() * sizeof(half_float::half));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)chunk.scale.data(), chunk.scale.size() * sizeof(half_float::half));
+	outfile.write((char*)top_opacity.data(), top_opacity.size() * sizeof(half_float::half));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)chunk.opacity.data(), chunk.opacity.size() * sizeof(half_float::half));
+	outfile.write((char*)top_shs.data(), top_shs.size() * sizeof(half_float::half));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)chunk.shs.data(), chunk.shs.size() * sizeof(half_float::half));
+
+	int allNB = (int)allN;
+	outfile.write((char*)(&allNB), sizeof(int));
+
+	// Top-level nodes and chunk roots share the first ids
+	std::vector<HalfNode> half_nodes(top.numNodes());
+	std::vector<HalfBox3> half_boxes(top.numNodes());
+	for (int top_id = 0; top_id < T; top_id++)
+	{
+		half_nodes[top.node_id[top_id]] = toHalf(top_nodes[top_id]);
+		for (int j = 0; j < 4; j++)
+		{
+			half_boxes[top.node_id[top_id]].minn[j] = top_boxes[top_id].minn[j];
+			half_boxes[top.node_id[top_id]].maxx[j] = top_boxes[top_id].maxx[j];
+		}
+	}
+	for (int chunk_id = 0; chunk_id < C; chunk_id++)
+	{
+		half_nodes[top.chunk_slot[chunk_id]] = rebasedNode(chunk_id, 0);
+		half_boxes[top.chunk_slot[chunk_id]] = chunks[chunk_id].boxes[0];
+	}
+	outfile.write((char*)half_nodes.data(), half_nodes.size() * sizeof(HalfNode));
+	for (int chunk_id = 0; chunk_id < C; chunk_id++)
+	{
+		int n = (int)chunks[chunk_id].nodes.size();
+		half_nodes.resize(n - 1);
+		for (int local_id = 1; local_id < n; local_id++)
+			half_nodes[local_id - 1] = rebasedNode(chunk_id, local_id);
+		outfile.write((char*)half_nodes.data(), half_nodes.size() * sizeof(HalfNode));
+	}
+
+	outfile.write((char*)half_boxes.data(), half_boxes.size() * sizeof(HalfBox3));
+	for (const SplicedChunk& chunk : chunks)
+		outfile.write((char*)(chunk.boxes.data() + 1), (chunk.boxes.size() - 1) * sizeof(HalfBox3));
+
+	if (!outfile.good())
+		throw std::runtime_error("Failed to write merged hierarchy!");
+}
+
+void HierarchySplicer::merge(
+	const std::vector<std::string>& chunk_files,
+	const std::vector<Eigen::Vector3f>& chunk_centers,
+	const char* filename)
+{
+	int C = (int)chunk_files.size();
+	std::vector<SplicedChunk> chunks(C);
+	std::vector<std::string> errors(C);
+
+	// Only a few unfiltered chunks are alive at any time, one per thread
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int chunk_id = 0; chunk_id < C; chunk_id++)
+	{
+		try
+		{
+			readChunk(chunk_files[chunk_id], chunks[chunk_id]);
+			filterChunk(chunks[chunk_id], chunk_id, chunk_centers);
+		}
+		catch (const std::exception& e)
+		{
+			errors[chunk_id] = chunk_files[chunk_id] + ": " + e.what();
+		}
+	}
+	for (const std::string& error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
+
+	writeSpliced(chunks, chunk_centers, filename);
+}
+
+void HierarchySplicer::replace(
+	const char* merged_file,
+	int chunk_id,
+	const std::string& chunk_file,
+	const std::vector<Eigen::Vector3f>& chunk_centers,
+	const char* filename)
+{
+	int C = (int)chunk_centers.size();
+	if (chunk_id < 0 || chunk_id >= C)
+		throw std::runtime_error("Chunk index out of range");
+
+	TopLevel top;
+	buildTopLevel(chunk_centers, top);
+
+	SplicedChunk merged;
+	readChunk(merged_file, merged);
+	if ((int)merged.nodes.size() < top.numNodes() || merged.nodes[0].count_children != (int)top.children[0].size())
+		throw std::runtime_error("Merged hierarchy does not match the chunk list");
+
+	// Only the changed chunk is weighed again, the others keep their subtrees
+	std::vector<SplicedChunk> chunks(C);
+	std::vector<std::string> errors(C);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < C; c++)
+	{
+		try
+		{
+			if (c == chunk_id)
+			{
+				readChunk(chunk_file, chunks[c]);
+				filterChunk(chunks[c], c, chunk_centers);
+			}
+			else
+			{
+				spliceSubtree(merged, top.chunk_slot[c], nullptr, chunks[c]);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			errors[c] = (c == chunk_id ? chunk_file : std::string(merged_file)) + ": " + e.what();
+		}
+	}
+	for (const std::string& error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
+
+	merged = SplicedChunk();
+	writeSpliced(chunks, chunk_centers, filename);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <Eigen/Dense>
+#include "common.h"
+
+// Merges chunk hierarchies without going through Gaussian and
+// ExplicitTreeNode. Chunks are loaded concurrently and kept in the half
+// precision encoding of the file; each one is filtered and weighted against
+// the other chunk centers in place. Nodes without any Gaussian of positive
+// weight are dropped and their children move up, as HierarchyExplicitLoader
+// does. The chunk roots are placed below a kd-tree on the chunk centers,
+// whose nodes hold at most 4 chunk roots and are merged with ClusterMerger
+// moment matching. The chunk arrays are spliced below it with rebased node
+// and Gaussian indices and written one section at a time, so peak memory
+// stays close to one copy of the output.
+class HierarchySplicer
+{
+public:
+	static void merge(
+		const std::vector<std::string>& chunk_files,
+		const std::vector<Eigen::Vector3f>& chunk_centers,
+		const char* filename);
+
+	// Writes to filename the hierarchy merge would produce for the chunks of
+	// merged_file with chunk chunk_id replaced by chunk_file. Only the new
+	// chunk is read and weighed, the subtrees of the other chunks are copied
+	// from merged_file and the top levels are rebuilt over the chunk roots.
+	static void replace(
+		const char* merged_file,
+		int chunk_id,
+		const std::string& chunk_file,
+		const std::vector<Eigen::Vector3f>& chunk_centers,
+		const char* filename);
+};
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "hierarchy_view.h"
+#include "hierarchy_loader.h"
+#include "traversal.h"
+#include <algorithm>
+
+HierarchyView::HierarchyView(
+	std::vector<Eigen::Vector3f>&& positions,
+	std::vector<SHs>&& shs,
+	std::vector<float>&& alphas,
+	std::vector<Eigen::Vector3f>&& scales,
+	std::vector<Eigen::Vector4f>&& rotations,
+	std::vector<Node>&& nodes,
+	std::vector<Box>&& boxes) :
+	position_data(std::move(positions)),
+	sh_data(std::move(shs)),
+	alpha_data(std::move(alphas)),
+	scale_data(std::move(scales)),
+	rotation_data(std::move(rotations)),
+	node_data(std::move(nodes)),
+	box_data(std::move(boxes))
+{
+}
+
+std::shared_ptr<const HierarchyView> HierarchyView::load(const char* filename)
+{
+	std::vector<Eigen::Vector3f> pos;
+	std::vector<SHs> shs;
+	std::vector<float> alphas;
+	std::vector<Eigen::Vector3f> scales;
+	std::vector<Eigen::Vector4f> rot;
+	std::vector<Node> nodes;
+	std::vector<Box> boxes;
+	HierarchyLoader::load(filename, pos, shs, alphas, scales, rot, nodes, boxes);
+
+	return std::make_shared<const HierarchyView>(
+		std::move(pos), std::move(shs), std::move(alphas), std::move(scales), std::move(rot), std::move(nodes), std::move(boxes));
+}
+
+TraversalSession::TraversalSession(std::shared_ptr<const HierarchyView> view) :
+	view(std::move(view))
+{
+}
+
+int TraversalSession::update(const Point& viewpoint, float target_size)
+{
+	const Node* nodes = view->nodes();
+	const Box* boxes = view->boxes();
+	float t2 = Traversal::squaredTarget(target_size);
+
+	active.clear();
+	nodes_to_expand.clear();
+	num_gaussians = 0;
+	if (view->numNodes() == 0)
+		return 0;
+
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		int node_id = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[node_id];
+		const Box& box = boxes[node_id];
+		bool split = false;
+		if (node.depth != 0) // Leaves never split
+		{
+			Point diff = viewpoint - (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+			float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+			if (Traversal::reachesSize(box, dist2, t2, viewpoint))
+			{
+				if (node.start_children == -1)
+					nodes_to_expand.push_back(node_id);
+				else
+					split = true;
+			}
+		}
+
+		active.push_back((node_id << 1) | (split ? 1 : 0));
+		num_gaussians += node.count_leafs;
+		if (split)
+		{
+			for (int i = 0; i < node.count_children; i++)
+				stack.push_back(node.start_children + i);
+		}
+		else if (node.depth > 0)
+		{
+			num_gaussians += node.count_merged;
+		}
+	}
+
+	std::sort(active.begin(), active.end());
+	return (int)active.size();
+}
+
+int TraversalSession::getRenderIndices(
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices) const
+{
+	const Node* nodes = view->nodes();
+
+	int num_active = active.size();
+	std::vector<int> node_ids(num_active), counts(num_active);
+	for (int idx = 0; idx < num_active; idx++)
+	{
+		int node_id = active[idx] >> 1;
+		const Node& node = nodes[node_id];
+		int count = node.count_leafs;
+		if (node.depth > 0 && !(active[idx] & 1))
+			count += node.count_merged;
+		node_ids[idx] = node_id;
+		counts[idx] = count;
+	}
+	return Traversal::putRenderIndices(nodes, num_active, node_ids.data(), counts.data(), render_indices, parent_indices, nodes_of_render_indices);
+}
+
+size_t TraversalSession::memoryFootprint() const
+{
+	return sizeof(TraversalSession)
+		+ (active.capacity() + stack.capacity() + nodes_to_expand.capacity()) * sizeof(int);
+}
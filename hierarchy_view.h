@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "common.h"
+
+// Loaded hierarchy that is never modified after construction. Any number of
+// threads may read it at the same time, sessions share it through a shared_ptr.
+class HierarchyView
+{
+public:
+	HierarchyView(
+		std::vector<Eigen::Vector3f>&& positions,
+		std::vector<SHs>&& shs,
+		std::vector<float>&& alphas,
+		std::vector<Eigen::Vector3f>&& scales,
+		std::vector<Eigen::Vector4f>&& rotations,
+		std::vector<Node>&& nodes,
+		std::vector<Box>&& boxes);
+
+	static std::shared_ptr<const HierarchyView> load(const char* filename);
+
+	int numNodes() const { return (int)node_data.size(); }
+	int numGaussians() const { return (int)position_data.size(); }
+
+	const Node* nodes() const { return node_data.data(); }
+	const Box* boxes() const { return box_data.data(); }
+	const Eigen::Vector3f* positions() const { return position_data.data(); }
+	const SHs* shs() const { return sh_data.data(); }
+	const float* alphas() const { return alpha_data.data(); }
+	const Eigen::Vector3f* scales() const { return scale_data.data(); }
+	const Eigen::Vector4f* rotations() const { return rotation_data.data(); }
+
+private:
+	const std::vector<Eigen::Vector3f> position_data;
+	const std::vector<SHs> sh_data;
+	const std::vector<float> alpha_data;
+	const std::vector<Eigen::Vector3f> scale_data;
+	const std::vector<Eigen::Vector4f> rotation_data;
+	const std::vector<Node> node_data;
+	const std::vector<Box> box_data;
+};
+
+// Cut state of one viewer. Same cut rules as IncrementalTraversal (a node is
+// split when its size reaches the target, active nodes are the root and all
+// children of split nodes), but only the active nodes are stored, so a session
+// costs O(cut) memory regardless of the hierarchy size. Each update walks down
+// from the root through the split nodes only. Sessions never write to the view,
+// one session per thread needs no locking.
+class TraversalSession
+{
+public:
+	TraversalSession(std::shared_ptr<const HierarchyView> view);
+
+	// Returns the number of active nodes
+	int update(const Point& viewpoint, float target_size);
+
+	// Same layout as putRenderIndicesIndexed, ordered by node id
+	int getRenderIndices(
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_of_render_indices = nullptr) const;
+
+	int numActive() const { return (int)active.size(); }
+	int numGaussians() const { return num_gaussians; }
+
+	// Nodes that should be split but have no children loaded (start_children == -1)
+	const std::vector<int>& nodesToExpand() const { return nodes_to_expand; }
+
+	// Bytes held by this session, without the shared view
+	size_t memoryFootprint() const;
+
+	const HierarchyView& hierarchy() const { return *view; }
+
+private:
+	std::shared_ptr<const HierarchyView> view;
+
+	// Active node ids shifted left by one, lowest bit set for split nodes, sorted
+	std::vector<int> active;
+	std::vector<int> stack;
+	std::vector<int> nodes_to_expand;
+	int num_gaussians = 0;
+};
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "incremental_traversal.h"
+#include "traversal.h"
+#include <algorithm>
+
+IncrementalTraversal::IncrementalTraversal(int N, Node* nodes, Box* boxes, float hysteresis) :
+	N(N), nodes(nodes), boxes(boxes), hysteresis(hysteresis),
+	split(N, 0), active(N, 0), listed(N, 0), stamps(N, 0)
+{
+}
+
+// Distance the viewpoint can move before it may enter or leave the box
+static float distanceToSurface(const Box& box, const Point& viewpoint)
+{
+	if (Traversal::inbox(box, viewpoint))
+	{
+		float d = FLT_MAX;
+		for (int i = 0; i < 3; i++)
+			d = std::min(d, std::min(viewpoint[i] - box.minn[i], box.maxx[i] - viewpoint[i]));
+		return d;
+	}
+
+	Point outside;
+	for (int i = 0; i < 3; i++)
+		outside[i] = std::max(std::max(box.minn[i] - viewpoint[i], viewpoint[i] - box.maxx[i]), 0.0f);
+	return outside.norm();
+}
+
+void IncrementalTraversal::activate(int node_id)
+{
+	active[node_id] = 1;
+	stamps[node_id]++;
+	if (!listed[node_id])
+		added.push_back(node_id);
+	worklist.push_back(node_id);
+}
+
+void IncrementalTraversal::deactivate(int node_id)
+{
+	active[node_id] = 0;
+	stamps[node_id]++;
+	if (listed[node_id])
+		removed++;
+}
+
+void IncrementalTraversal::schedule(int node_id, float safe_distance)
+{
+	events.push_back({ odometer + std::max(safe_distance, 0.0f), node_id, stamps[node_id] });
+	std::push_heap(events.begin(), events.end());
+}
+
+void IncrementalTraversal::splitNode(int node_id)
+{
+	const Node& node = nodes[node_id];
+	if (node.start_children == -1)
+	{
+		nodes_to_expand.push_back(node_id);
+		return;
+	}
+
+	split[node_id] = 1;
+	changes++;
+	for (int i = 0; i < node.count_children; i++)
+		activate(node.start_children + i);
+}
+
+void IncrementalTraversal::collapseNode(int node_id)
+{
+	split[node_id] = 0;
+	changes++;
+
+	std::vector<int>& stack = worklist;
+	size_t base = stack.size();
+	const Node& node = nodes[node_id];
+	for (int i = 0; i < node.count_children; i++)
+		stack.push_back(node.start_children + i);
+
+	while (stack.size() > base)
+	{
+		int child_id = stack.back();
+		stack.pop_back();
+
+		deactivate(child_id);
+		if (split[child_id])
+		{
+			split[child_id] = 0;
+			const Node& child = nodes[child_id];
+			for (int i = 0; i < child.count_children; i++)
+				stack.push_back(child.start_children + i);
+		}
+	}
+}
+
+void IncrementalTraversal::evaluate(int node_id)
+{
+	const Node& node = nodes[node_id];
+	if (node.depth == 0) // Leaves never split, nothing to watch
+		return;
+
+	const Box& box = boxes[node_id];
+	Point point = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+	Point diff = viewpoint - point;
+	float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+
+	float collapse_size = (1.0f - hysteresis) * target_size;
+	if (!split[node_id] && Traversal::reachesSize(box, dist2, Traversal::squaredTarget(target_size), viewpoint))
+		splitNode(node_id);
+	else if (split[node_id] && !Traversal::reachesSize(box, dist2, Traversal::squaredTarget(collapse_size), viewpoint))
+		collapseNode(node_id);
+
+	if (node.start_children == -1) // Re-check on every move until children arrive
+	{
+		schedule(node_id, 0);
+		return;
+	}
+
+	float threshold = split[node_id] ? collapse_size : target_size;
+	float dist = sqrt(dist2);
+	float radius = box.maxx[3] / threshold;
+	float safe = std::min(std::abs(dist - radius), distanceToSurface(box, viewpoint));
+	float slack = 1e-5f * (dist + radius + viewpoint.cwiseAbs().maxCoeff());
+	schedule(node_id, safe - slack);
+}
+
+void IncrementalTraversal::mergeActiveList()
+{
+	// Most updates change nothing, keep those from touching the whole cut
+	if (added.empty() && removed == 0)
+		return;
+
+	if (removed != 0)
+	{
+		size_t kept = 0;
+		for (int node_id : active_list)
+		{
+			if (active[node_id])
+				active_list[kept++] = node_id;
+			else
+				listed[node_id] = 0;
+		}
+		active_list.resize(kept);
+		removed = 0;
+	}
+
+	std::sort(added.begin(), added.end());
+	added.erase(std::unique(added.begin(), added.end()), added.end());
+	size_t fresh = 0;
+	for (int node_id : added)
+	{
+		if (active[node_id] && !listed[node_id])
+		{
+			listed[node_id] = 1;
+			added[fresh++] = node_id;
+		}
+	}
+	added.resize(fresh);
+	if (added.empty())
+		return;
+
+	merged_list.resize(active_list.size() + added.size());
+	std::merge(active_list.begin(), active_list.end(), added.begin(), added.end(), merged_list.begin());
+	active_list.swap(merged_list);
+	added.clear();
+}
+
+void IncrementalTraversal::rebuild(const Point& viewpoint, float target_size)
+{
+	for (int node_id : active_list)
+	{
+		split[node_id] = 0;
+		listed[node_id] = 0;
+		deactivate(node_id);
+	}
+	active_list.clear();
+	removed = 0;
+	events.clear();
+	nodes_to_expand.clear();
+
+	this->viewpoint = viewpoint;
+	this->target_size = target_size;
+	odometer = 0;
+	changes = 0;
+
+	activate(0);
+	while (!worklist.empty())
+	{
+		int node_id = worklist.back();
+		worklist.pop_back();
+		if (active[node_id])
+			evaluate(node_id);
+	}
+	mergeActiveList();
+}
+
+int IncrementalTraversal::update(const Point& viewpoint, float target_size)
+{
+	if (target_size != this->target_size || active_list.empty())
+	{
+		rebuild(viewpoint, target_size);
+		return changes;
+	}
+
+	changes = 0;
+	nodes_to_expand.clear();
+	odometer += (viewpoint - this->viewpoint).norm();
+	this->viewpoint = viewpoint;
+
+	while (!events.empty() && events.front().key < odometer)
+	{
+		std::pop_heap(events.begin(), events.end());
+		Event e = events.back();
+		events.pop_back();
+
+		if (!active[e.node_id] || stamps[e.node_id] != e.stamp)
+			continue;
+
+		evaluate(e.node_id);
+		while (!worklist.empty())
+		{
+			int node_id = worklist.back();
+			worklist.pop_back();
+			if (active[node_id])
+				evaluate(node_id);
+		}
+	}
+	mergeActiveList();
+
+	// Drop events of nodes that left the cut once they dominate the queue
+	if (events.size() > 4 * active_list.size() + 1024)
+	{
+		auto stale = [&](const Event& e) { return !active[e.node_id] || stamps[e.node_id] != e.stamp; };
+		events.erase(std::remove_if(events.begin(), events.end(), stale), events.end());
+		std::make_heap(events.begin(), events.end());
+	}
+
+	return changes;
+}
+
+int IncrementalTraversal::getRenderIndices(
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices)
+{
+	int num_active = active_list.size();
+	if (num_active == 0)
+		return 0;
+
+	render_offsets.resize(num_active);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < num_active; idx++)
+	{
+		int node_id = active_list[idx];
+		const Node& node = nodes[node_id];
+		int count = node.count_leafs;
+		if (node.depth > 0 && split[node_id] == 0)
+			count += node.count_merged;
+		render_offsets[idx] = count;
+	}
+
+	return Traversal::putRenderIndices(nodes, num_active, active_list.data(), render_offsets.data(), render_indices, parent_indices, nodes_of_render_indices);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include "common.h"
+
+// CPU counterpart of Switching::changeToSizeStep. Keeps the active nodes and
+// their split state between frames. A node is split when its size reaches the
+// target, the active nodes are the root and all children of split nodes.
+//
+// Every active node that can change state is queued with the distance the camera
+// still has to travel before it may cross the node's switch sphere or box. Only
+// nodes whose distance was used up are re-evaluated, so the work per update
+// follows the change of the cut, not its size.
+//
+// With hysteresis h > 0, split nodes only collapse again once their size drops
+// below (1 - h) * target_size. With h = 0, update() gives exactly the cut that
+// rebuild() computes from scratch for the same viewpoint and target size.
+class IncrementalTraversal
+{
+public:
+	IncrementalTraversal(int N, Node* nodes, Box* boxes, float hysteresis = 0.0f);
+
+	// Full top-down re-traversal from the root
+	void rebuild(const Point& viewpoint, float target_size);
+
+	// Incremental step, falls back to rebuild() when the target size changes.
+	// Returns the number of nodes that were split or collapsed.
+	int update(const Point& viewpoint, float target_size);
+
+	// Same layout as putRenderIndicesIndexed, ordered by node id
+	int getRenderIndices(
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_of_render_indices = nullptr);
+
+	const std::vector<int>& activeNodes() const { return active_list; }
+	const std::vector<char>& splitState() const { return split; }
+
+	// Nodes that should be split but have no children loaded (start_children == -1)
+	const std::vector<int>& nodesToExpand() const { return nodes_to_expand; }
+
+private:
+
+	struct Event
+	{
+		double key;
+		int node_id;
+		int stamp;
+
+		bool operator<(const Event& other) const { return key > other.key; }
+	};
+
+	void evaluate(int node_id);
+	void splitNode(int node_id);
+	void collapseNode(int node_id);
+	void activate(int node_id);
+	void deactivate(int node_id);
+	void schedule(int node_id, float safe_distance);
+	void mergeActiveList();
+
+	int N;
+	Node* nodes;
+	Box* boxes;
+	float hysteresis;
+
+	Point viewpoint;
+	float target_size = -1.0f;
+	double odometer = 0;
+	int changes = 0;
+	int removed = 0; // listed nodes deactivated since the last merge
+
+	std::vector<char> split;
+	std::vector<char> active;
+	std::vector<char> listed;
+	std::vector<int> stamps;
+
+	std::vector<int> active_list;
+	std::vector<int> merged_list;
+	std::vector<int> added;
+	std::vector<int> worklist;
+	std::vector<int> nodes_to_expand;
+	std::vector<Event> events;
+	std::vector<int> render_offsets;
+};
@@ -269,4 +269,53 @@ uint32_t Loader::loadBin(const char* filename, std::vector<Gaussian>& gaussians,
 		computeCovariance(g.scale, g.rotation, g.covariance);
 	}
 	return 3; //sh_degree
-}
\ No newline at end of file
+}
+
+size_t Loader::openPly(const char* filename, std::ifstream& infile, std::vector<std::string>& properties)
+{
+	infile.open(filename, std::ios_base::binary);
+	if (!infile.good())
+		throw std::runtime_error("File not found!");
+
+	std::string buff;
+	std::getline(infile, buff);
+	if (buff.compare(0, 3, "ply") != 0)
+		throw std::runtime_error("Invalid ply files!");
+
+	size_t count = 0;
+	bool vertex = false;
+	properties.clear();
+	while (std::getline(infile, buff))
+	{
+		if (!buff.empty() && buff.back() == '\r')
+			buff.pop_back();
+		if (buff.compare("end_header") == 0)
+			break;
+
+		std::stringstream ss(buff);
+		std::string keyword, type;
+		ss >> keyword;
+		if (keyword == "format" && buff.find("binary_little_endian") == std::string::npos)
+			throw std::runtime_error("Only binary little endian ply files are supported!");
+		if (keyword == "element")
+		{
+			std::string name;
+			ss >> name;
+			vertex = name == "vertex";
+			if (vertex)
+				ss >> count;
+			else
+				throw std::runtime_error("Only ply files with vertices are supported!");
+		}
+		if (keyword == "property" && vertex)
+		{
+			ss >> type;
+			if (type != "float" && type != "float32")
+				throw std::runtime_error("Only float properties are supported!");
+			properties.push_back(buff);
+		}
+	}
+	if (properties.size() < 3)
+		throw std::runtime_error("Invalid ply files!");
+	return count;
+}
@@ -13,6 +13,8 @@
 
 #include "common.h"
 #include <vector>
+#include <string>
+#include <fstream>
 
 class Loader
 {
@@ -22,4 +24,9 @@ public:
 	static uint32_t loadPly(const char* filename, std::vector<Gaussian>& gaussian, int skyboxpoints = 0);
 
 	static uint32_t loadBin(const char* filename, std::vector<Gaussian>& gaussian, int skyboxpoints = 0);
+
+	// Reads the header of a binary ply and leaves infile at the first vertex,
+	// for reading the vertices in blocks. properties holds the property lines
+	// of the vertex element, which must all be floats. Returns the vertex count.
+	static size_t openPly(const char* filename, std::ifstream& infile, std::vector<std::string>& properties);
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "chunk_splitter.h"
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+// Splits a .ply or .bin scene into chunk folders with point_cloud.ply and
+// center.txt, as GaussianHierarchyMerger reads them. The mode is "kd" with
+// a target vertex count per chunk, or "grid" with a cell size. The margin is
+// in scene units, vertices that close to a chunk are also written to it.
+int main(int argc, char* argv[])
+{
+	if (argc < 5)
+		throw std::runtime_error("Failed to pass args <input> <output_dir> <kd|grid> <target_count|cell_size> [margin]");
+
+	std::string mode(argv[3]);
+	float margin = argc > 5 ? std::stof(argv[5]) : 0.f;
+
+	ChunkSplitter splitter(argv[1]);
+	std::cout << "Vertices: " << splitter.numVertices() << std::endl;
+
+	if (mode == "kd")
+		splitter.partitionKd(std::stoull(argv[4]));
+	else if (mode == "grid")
+		splitter.partitionGrid(std::stof(argv[4]));
+	else
+		throw std::runtime_error("Mode must be kd or grid");
+
+	std::vector<std::string> names = splitter.write(argv[2], margin);
+
+	// Chunk list in the form the merger takes it
+	std::cout << "Chunks:";
+	for (const std::string& name : names)
+		std::cout << " " << name;
+	std::cout << std::endl;
+}
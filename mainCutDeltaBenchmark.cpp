@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "hierarchy_loader.h"
+#include "traversal.h"
+#include "cut_delta.h"
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+// Replays a recorded camera path through the CPU traversal and compares the
+// size of full render indices against the serialized cut deltas per frame.
+// The camera path is a text file with one position "x y z" per line.
+int main(int argc, char* argv[])
+{
+	if (argc < 4)
+		throw std::runtime_error("Failed to pass args <hierarchy_file> <camera_path> <target_size>");
+
+	std::vector<Eigen::Vector3f> pos;
+	std::vector<SHs> shs;
+	std::vector<float> alphas;
+	std::vector<Eigen::Vector3f> scales;
+	std::vector<Eigen::Vector4f> rot;
+	std::vector<Node> nodes;
+	std::vector<Box> boxes;
+	HierarchyLoader::load(argv[1], pos, shs, alphas, scales, rot, nodes, boxes);
+
+	std::vector<Eigen::Vector3f> path;
+	std::ifstream infile(argv[2]);
+	if (!infile.good())
+		throw std::runtime_error("Could not open camera path");
+	std::string line;
+	while (std::getline(infile, line))
+	{
+		std::istringstream iss(line);
+		Eigen::Vector3f p;
+		if (iss >> p[0] >> p[1] >> p[2])
+			path.push_back(p);
+	}
+
+	float target_size = std::stof(argv[3]);
+	int N = (int)nodes.size();
+	int P = (int)pos.size();
+
+	std::vector<int> render_indices(P), parent_indices(P), nodes_for_render_indices(P);
+	std::vector<int> client_indices(P), client_parents(P), client_nodes(P);
+
+	CutDeltaEncoder encoder;
+	CutDeltaDecoder decoder;
+	CutDelta sent, received;
+	std::vector<uint8_t> buffer;
+
+	size_t full_bytes = 0, delta_bytes = 0, max_delta_bytes = 0;
+	double encode_ms = 0, apply_ms = 0;
+	int mismatches = 0;
+
+	for (size_t f = 0; f < path.size(); f++)
+	{
+		int count = Traversal::expandToSize(N, target_size, nodes.data(), boxes.data(), path[f],
+			render_indices.data(), nullptr, parent_indices.data(), nodes_for_render_indices.data());
+
+		auto t0 = std::chrono::steady_clock::now();
+		encoder.encode(count, render_indices.data(), parent_indices.data(), nodes_for_render_indices.data(), sent);
+		sent.serialize(buffer);
+		auto t1 = std::chrono::steady_clock::now();
+		received.deserialize(buffer.data(), buffer.size());
+		if (!decoder.apply(received))
+		{
+			encoder.requestResync();
+			mismatches++;
+		}
+		int client_count = decoder.getRenderIndices(client_indices.data(), client_parents.data(), client_nodes.data());
+		auto t2 = std::chrono::steady_clock::now();
+
+		encode_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		apply_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+		bool same = client_count == count;
+		for (int i = 0; same && i < count; i++)
+			same = client_indices[i] == render_indices[i] && client_parents[i] == parent_indices[i] && client_nodes[i] == nodes_for_render_indices[i];
+		if (!same)
+			mismatches++;
+
+		// Full transfer sends render and parent indices
+		full_bytes += (size_t)count * 2 * sizeof(int);
+		if (f != 0)
+		{
+			delta_bytes += buffer.size();
+			max_delta_bytes = std::max(max_delta_bytes, buffer.size());
+		}
+	}
+
+	size_t frames = path.size() > 1 ? path.size() - 1 : 1;
+	std::cout << "Frames: " << path.size() << std::endl;
+	std::cout << "Average full transfer: " << full_bytes / std::max<size_t>(path.size(), 1) << " bytes" << std::endl;
+	std::cout << "Average delta transfer: " << delta_bytes / frames << " bytes (max " << max_delta_bytes << ")" << std::endl;
+	std::cout << "Average encode: " << encode_ms / std::max<size_t>(path.size(), 1) << " ms, apply: " << apply_ms / std::max<size_t>(path.size(), 1) << " ms" << std::endl;
+	std::cout << "Mismatches: " << mismatches << std::endl;
+
+	return mismatches == 0 ? 0 : 1;
+}
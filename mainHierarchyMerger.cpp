@@ -14,11 +14,11 @@
 #include "writer.h"
 #include "FlatGenerator.h"
 #include "PointbasedKdTreeGenerator.h"
-#include "AvgMerger.h"
 #include "ClusterMerger.h"
 #include "common.h"
 #include "dependencies/json.hpp"
 #include "hierarchy_explicit_loader.h"
+#include "hierarchy_splicer.h"
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -42,6 +42,15 @@ void recTraverse(ExplicitTreeNode* node, int& zerocount)
 	}
 }
 
+void recDelete(ExplicitTreeNode* node)
+{
+	for (auto c : node->children)
+	{
+		recDelete(c);
+	}
+	delete node;
+}
+
 int main(int argc, char* argv[])
 {
 	if (argc < 5)
@@ -80,11 +89,7 @@ int main(int argc, char* argv[])
 			chunk_centers[chunk_id] = chunk_center;
 		}
 
-		// Read per chunk hierarchies and discard unwanted primitives 
-		// based on the distance to the chunk's center
-		std::vector<Gaussian> gaussians; 
-		ExplicitTreeNode* root = new ExplicitTreeNode;
-
+		std::vector<std::string> hierpaths(chunk_count);
 		for (int chunk_id(0); chunk_id < chunk_count; chunk_id++)
 		{
 			int argidx(chunk_id + 5);
@@ -95,43 +100,28 @@ int main(int argc, char* argv[])
 				hierpath = rootpath + "/" + argv[argidx] + "/hierarchy.hier"; // without opt
 			std::cout << "Hierarchy file path: " << hierpath << std::endl;
 			hierFile.close();
-			
-			ExplicitTreeNode* chunkRoot = new ExplicitTreeNode;
-			HierarchyExplicitLoader::loadExplicit(hierpath.c_str(), gaussians, chunkRoot, chunk_id, chunk_centers);
-
-			if (chunk_id == 0)
-			{
-				root->bounds = chunkRoot->bounds;
-			}
-			else
-			{	
-				for (int idx(0); idx < 3; idx++)
-				{
-					root->bounds.minn[idx] = std::min(root->bounds.minn[idx], chunkRoot->bounds.minn[idx]);
-					root->bounds.maxx[idx] = std::max(root->bounds.maxx[idx], chunkRoot->bounds.maxx[idx]);
-				}
-			}
-			root->depth = std::max(root->depth, chunkRoot->depth + 1);
-			root->children.push_back(chunkRoot);
-			root->merged.push_back(chunkRoot->merged[0]);
-			root->bounds.maxx[3] = 1e9f;
-			root->bounds.minn[3] = 1e9f;
-		}
-		if (chunk_count > 1) {
-			Gaussian gaussian = AvgMerger::mergeGaussians(root->merged);
-			root->merged.clear();
-			root->merged.emplace_back(gaussian);
+			hierpaths[chunk_id] = hierpath;
 		}
 
 		std::string ext = outputpath.substr(outputpath.size() - 4);
 		if (ext != ".ply") {
-			Writer::writeHierarchy(
-				outputpath.c_str(),
-				gaussians, root, true);
+			// Splice the chunk arrays directly, no explicit tree needed
+			HierarchySplicer::merge(hierpaths, chunk_centers, outputpath.c_str());
+			return 0;
 		}
-		else {
-			gaussians.insert(gaussians.begin(), gaussians_sky.begin(), gaussians_sky.end());
-			Writer::writePly(outputpath.c_str(), gaussians, sh_degree);
+
+		// Read per chunk hierarchies and discard unwanted primitives 
+		// based on the distance to the chunk's center
+		std::vector<Gaussian> gaussians; 
+
+		for (int chunk_id(0); chunk_id < chunk_count; chunk_id++)
+		{
+			ExplicitTreeNode* chunkRoot = new ExplicitTreeNode;
+			HierarchyExplicitLoader::loadExplicit(hierpaths[chunk_id].c_str(), gaussians, chunkRoot, chunk_id, chunk_centers);
+			recDelete(chunkRoot);
 		}
+
+		gaussians.insert(gaussians.begin(), gaussians_sky.begin(), gaussians_sky.end());
+		Writer::writePly(outputpath.c_str(), gaussians, sh_degree);
 	}
 }
\ No newline at end of file
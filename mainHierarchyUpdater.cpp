@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "hierarchy_splicer.h"
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+// Replaces one re-trained chunk in a hierarchy written by GaussianHierarchyMerger.
+// rootpath, inpath and the chunk names are those given to the merger, in the
+// same order; changed_chunk is the name of the chunk to take again from rootpath.
+int main(int argc, char* argv[])
+{
+	if (argc < 7)
+		throw std::runtime_error("Failed to pass args <merged_hierarchy> <rootpath> <inpath> <output> <changed_chunk> <chunk names...>");
+
+	std::string mergedpath(argv[1]);
+	std::string rootpath(argv[2]);
+	std::string inpath(argv[3]);
+	std::string outputpath(argv[4]);
+	std::string changed(argv[5]);
+	int chunk_count(argc - 6);
+
+	if (outputpath == mergedpath)
+		throw std::runtime_error("Output must not overwrite the merged hierarchy");
+
+	int changed_id = -1;
+	std::vector<Eigen::Vector3f> chunk_centers(chunk_count);
+	for (int chunk_id(0); chunk_id < chunk_count; chunk_id++)
+	{
+		int argidx(chunk_id + 6);
+		if (changed == argv[argidx])
+			changed_id = chunk_id;
+
+		std::ifstream f(inpath + "/" + argv[argidx] + "/center.txt");
+		Eigen::Vector3f chunk_center(0.f, 0.f, 0.f);
+		f >> chunk_center[0]; f >> chunk_center[1]; f >> chunk_center[2];
+		chunk_centers[chunk_id] = chunk_center;
+	}
+	if (changed_id == -1)
+		throw std::runtime_error("Changed chunk is not in the chunk list");
+
+	std::string hierpath = rootpath + "/" + changed + "/hierarchy.hier_opt";
+	std::ifstream hierFile(hierpath, std::ios_base::binary);
+	if (!hierFile.good() || hierFile.peek() == std::ifstream::traits_type::eof())
+		hierpath = rootpath + "/" + changed + "/hierarchy.hier"; // without opt
+	hierFile.close();
+	std::cout << "Replacing chunk " << changed << " with " << hierpath << std::endl;
+
+	HierarchySplicer::replace(mergedpath.c_str(), changed_id, hierpath, chunk_centers, outputpath.c_str());
+}
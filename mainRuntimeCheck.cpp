@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "traversal.h"
+#include "switching_workspace.h"
+#include "runtime_maintenance_cpu.h"
+#include "incremental_traversal.h"
+#include "types.h"
+#include "half.hpp"
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+	if (!ok)
+		failures++;
+}
+
+// Complete binary tree over `levels` levels in breadth first order, so that
+// siblings are consecutive. Every node holds one Gaussian with the node's id,
+// a leaf Gaussian for leaves and a merged one otherwise. Boxes tile the x axis.
+struct SyntheticHierarchy
+{
+	std::vector<Node> nodes;
+	std::vector<Box> boxes;
+
+	SyntheticHierarchy(int levels)
+	{
+		int N = (1 << levels) - 1;
+		nodes.resize(N);
+		boxes.resize(N);
+		for (int level = 0; level < levels; level++)
+		{
+			int first = (1 << level) - 1;
+			float width = (float)(1 << (levels - 1 - level));
+			for (int k = 0; k <= first; k++)
+			{
+				int id = first + k;
+				bool leaf = level == levels - 1;
+
+				Node& node = nodes[id];
+				node.depth = levels - 1 - level;
+				node.parent = id == 0 ? -1 : (id - 1) / 2;
+				node.start = id;
+				node.count_leafs = leaf ? 1 : 0;
+				node.count_merged = leaf ? 0 : 1;
+				node.start_children = leaf ? -1 : 2 * id + 1;
+				node.count_children = leaf ? 0 : 2;
+
+				boxes[id] = Box(Eigen::Vector3f(k * width, 0, 0), Eigen::Vector3f((k + 1) * width, 1, 1));
+				boxes[id].maxx[3] = width;
+			}
+		}
+	}
+
+	int size() const { return (int)nodes.size(); }
+};
+
+// Host workspace: buffers are allocated once, reused while they are large
+// enough and grown otherwise; the expansion refuses workspaces that are too small
+static void checkWorkspace()
+{
+	SyntheticHierarchy h(8);
+	int N = h.size();
+	Point viewpoint(3.5f, 0.5f, 2.0f);
+	float target_size = 0.5f;
+
+	std::vector<int> expected(N), expected_parents(N);
+	int expected_count = Traversal::expandToSize(N, target_size, h.nodes.data(), h.boxes.data(), viewpoint, expected.data(), nullptr, expected_parents.data());
+	check(expected_count > 1 && expected_count < (N + 1) / 2, "cut lies between the root and the leaves");
+
+	SwitchingWorkspace workspace(std::make_shared<CPUWorkspaceBackend>());
+	check(!workspace.isDevice() && workspace.scratchSize() == 0, "host workspace needs no scratch");
+	check(workspace.reserve(N) && workspace.capacity() == N && workspace.allocations() == 1, "reserve allocates");
+
+	int* offsets = workspace.offsets();
+	check(!workspace.reserve(N / 2) && workspace.offsets() == offsets && workspace.allocations() == 1, "smaller reserve reuses the buffers");
+
+	std::vector<int> render_indices(N, -1), parent_indices(N, -1);
+	int count = Traversal::expandToSize(N, target_size, h.nodes.data(), h.boxes.data(), viewpoint, workspace, render_indices.data(), nullptr, parent_indices.data());
+	check(count == expected_count && workspace.result()[0] == count, "workspace expansion count");
+	check(std::equal(expected.begin(), expected.begin() + count, render_indices.begin()) &&
+		std::equal(expected_parents.begin(), expected_parents.begin() + count, parent_indices.begin()), "workspace expansion indices");
+
+	check(workspace.reserve(2 * N) && workspace.capacity() == 2 * N && workspace.allocations() == 2, "larger reserve grows");
+	count = Traversal::expandToSize(N, target_size, h.nodes.data(), h.boxes.data(), viewpoint, workspace, render_indices.data());
+	check(count == expected_count && std::equal(expected.begin(), expected.begin() + count, render_indices.begin()), "grown workspace expansion");
+
+	SwitchingWorkspace small(std::make_shared<CPUWorkspaceBackend>());
+	small.reserve(N - 1);
+	bool thrown = false;
+	try
+	{
+		Traversal::expandToSize(N, target_size, h.nodes.data(), h.boxes.data(), viewpoint, small, render_indices.data());
+	}
+	catch (const std::runtime_error&)
+	{
+		thrown = true;
+	}
+	check(thrown, "too small workspace is refused");
+
+	workspace.release();
+	check(workspace.capacity() == 0 && workspace.offsets() == nullptr, "release frees the buffers");
+}
+
+// Gaussian attribute spaces in the layout of the runtime, one value pattern per
+// Gaussian id so that moved Gaussians can be recognized
+struct GaussianSpaces
+{
+	std::vector<float> pos, rot, sh, alpha, scale;
+
+	GaussianSpaces(int P) : pos(3 * P), rot(4 * P), sh(48 * P), alpha(P), scale(3 * P)
+	{
+		for (int g = 0; g < P; g++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				pos[3 * g + i] = g * (i + 1.0f);
+				scale[3 * g + i] = 0.5f + g + i;
+			}
+			for (int i = 0; i < 4; i++)
+				rot[4 * g + i] = i == 0 ? 1.0f : 0.1f * g * i;
+			for (int i = 0; i < 48; i++)
+				sh[48 * g + i] = 0.01f * (g + 1) * (i - 24);
+			alpha[g] = 0.1f * (g + 1);
+		}
+	}
+
+	bool sameGaussian(const GaussianSpaces& other, int g, int other_g) const
+	{
+		return std::equal(&pos[3 * g], &pos[3 * g] + 3, &other.pos[3 * other_g]) &&
+			std::equal(&rot[4 * g], &rot[4 * g] + 4, &other.rot[4 * other_g]) &&
+			std::equal(&sh[48 * g], &sh[48 * g] + 48, &other.sh[48 * other_g]) &&
+			alpha[g] == other.alpha[other_g] &&
+			std::equal(&scale[3 * g], &scale[3 * g] + 3, &other.scale[3 * other_g]);
+	}
+};
+
+static unsigned short halfBits(float v)
+{
+	half_float::half h(v);
+	unsigned short bits;
+	std::memcpy(&bits, &h, sizeof(bits));
+	return bits;
+}
+
+// Compaction of a 3 level tree where the root and node 2 are split and node 1
+// is not, against the result worked out by hand, followed by the scale packing
+static void checkCompaction()
+{
+	SyntheticHierarchy h(3);
+	int topN = h.size();
+	GaussianSpaces src(topN);
+
+	std::vector<int> active = { 0, 1, 2, 5, 6 };
+	std::vector<int> split = { 1, 0, 1, 0, 0, 0, 0 };
+	std::vector<int> cuda2cpu(topN);
+	for (int i = 0; i < topN; i++)
+		cuda2cpu[i] = 100 + i;
+	int N = (int)active.size();
+
+	std::vector<Node> new_nodes(topN);
+	std::vector<Box> new_boxes(topN);
+	std::vector<int> new_active(N), new_split(topN), new_cuda2cpu(topN);
+	std::vector<int> NsrcI(topN), NsrcI2(topN), NdstI(topN), NdstI2(topN);
+	GaussianSpaces dst(topN);
+	char* scratch = nullptr;
+	size_t scratch_size = 0;
+	int node_count = 0, gaussian_count = 0;
+
+	MaintenanceCPU::compactPart1(topN, N, active.data(), new_active.data(), (const int*)h.nodes.data(), (const float*)h.boxes.data(),
+		src.pos.data(), src.rot.data(), src.sh.data(), src.alpha.data(), src.scale.data(), split.data(),
+		(int*)new_nodes.data(), (float*)new_boxes.data(), dst.pos.data(), dst.rot.data(), dst.sh.data(), dst.alpha.data(), dst.scale.data(), new_split.data(),
+		cuda2cpu.data(), new_cuda2cpu.data(), NsrcI.data(), NsrcI2.data(), NdstI.data(), NdstI2.data(), scratch, scratch_size, nullptr, &node_count);
+	MaintenanceCPU::compactPart2(topN, N, active.data(), new_active.data(), (const int*)h.nodes.data(), (const float*)h.boxes.data(),
+		src.pos.data(), src.rot.data(), src.sh.data(), src.alpha.data(), src.scale.data(), split.data(),
+		(int*)new_nodes.data(), (float*)new_boxes.data(), dst.pos.data(), dst.rot.data(), dst.sh.data(), dst.alpha.data(), dst.scale.data(), new_split.data(),
+		cuda2cpu.data(), new_cuda2cpu.data(), NsrcI.data(), NsrcI2.data(), NdstI.data(), NdstI2.data(), scratch, scratch_size, nullptr, &gaussian_count);
+	check(node_count == 5 && gaussian_count == 5, "compaction counts");
+
+	// Active nodes keep their order, node 1 loses its children, node 2 keeps
+	// them at their new ids 3 and 4
+	int expected_parent[5] = { -1, 0, 0, 2, 2 };
+	int expected_children[5] = { 1, -1, 3, -1, -1 };
+	int expected_split[5] = { 1, 0, 1, 0, 0 };
+	bool nodes_ok = true, gaussians_ok = true;
+	for (int i = 0; i < N; i++)
+	{
+		const Node& node = new_nodes[i];
+		const Node& old = h.nodes[active[i]];
+		nodes_ok &= node.parent == expected_parent[i] && node.start_children == expected_children[i] &&
+			node.start == i && node.depth == old.depth && node.count_children == old.count_children &&
+			new_split[i] == expected_split[i] && new_cuda2cpu[i] == 100 + active[i] && new_active[i] == i &&
+			new_boxes[i].minn == h.boxes[active[i]].minn && new_boxes[i].maxx == h.boxes[active[i]].maxx;
+		gaussians_ok &= dst.sameGaussian(src, i, active[i]);
+	}
+	check(nodes_ok, "compacted nodes");
+	check(gaussians_ok, "compacted Gaussians");
+	check(std::all_of(active.begin(), active.end(), [&](int id) { return split[id] == 0; }), "split flags are cleared");
+
+	// Every scale becomes a pair of halves, the own value low and the parent's high
+	MaintenanceCPU::compress(N, (int*)new_nodes.data(), dst.scale.data(), dst.rot.data(), dst.sh.data(), dst.alpha.data());
+	bool compressed_ok = true;
+	for (int i = 0; i < N; i++)
+	{
+		int parent_gaussian = expected_parent[i] == -1 ? i : expected_parent[i];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned short pair[2];
+			std::memcpy(pair, &dst.scale[3 * i + k], sizeof(float));
+			compressed_ok &= pair[0] == halfBits(src.scale[3 * active[i] + k]) &&
+				pair[1] == halfBits(src.scale[3 * active[parent_gaussian] + k]);
+		}
+	}
+	check(compressed_ok, "compressed scales");
+}
+
+static bool near(float a, float b, float tolerance)
+{
+	return std::fabs(a - b) <= tolerance;
+}
+
+// Half precision keeps 11 significant bits
+static bool nearHalf(float a, float b)
+{
+	return near(a, b, std::fabs(b) / 1024.0f + 1e-6f);
+}
+
+// Pack and unpack of a small tree: positions are exact, halves within their
+// precision, the higher SH bands within half a quantization step, and the
+// parent values are those of the parent node's first Gaussian
+static void checkPacking()
+{
+	check(sizeof(PackedGaussian) == 100, "packed Gaussian size");
+
+	SyntheticHierarchy h(3);
+	int N = h.size();
+	GaussianSpaces src(N);
+
+	std::vector<PackedGaussian> packed(N);
+	MaintenanceCPU::pack(N, (const int*)h.nodes.data(), src.pos.data(), src.rot.data(), src.sh.data(), src.alpha.data(), src.scale.data(), (char*)packed.data(), nullptr);
+
+	GaussianSpaces dst(N);
+	std::vector<float> parent_rot(4 * N), parent_alpha(N), parent_scale(3 * N);
+	MaintenanceCPU::unpack(N, (const char*)packed.data(), dst.pos.data(), dst.rot.data(), dst.sh.data(), dst.alpha.data(), dst.scale.data(),
+		parent_rot.data(), parent_alpha.data(), parent_scale.data());
+
+	bool own_ok = true, sh_ok = true, parent_ok = true;
+	for (int g = 0; g < N; g++)
+	{
+		int parent = h.nodes[g].parent == -1 ? g : h.nodes[h.nodes[g].parent].start;
+		for (int i = 0; i < 3; i++)
+		{
+			own_ok &= dst.pos[3 * g + i] == src.pos[3 * g + i] && nearHalf(dst.scale[3 * g + i], src.scale[3 * g + i]);
+			parent_ok &= nearHalf(parent_scale[3 * g + i], src.scale[3 * parent + i]);
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			own_ok &= nearHalf(dst.rot[4 * g + i], src.rot[4 * g + i]);
+			parent_ok &= nearHalf(parent_rot[4 * g + i], src.rot[4 * parent + i]);
+		}
+		own_ok &= nearHalf(dst.alpha[g], src.alpha[g]);
+		parent_ok &= nearHalf(parent_alpha[g], src.alpha[parent]);
+
+		float maxabs = 0;
+		for (int i = 3; i < 48; i++)
+			maxabs = std::max(maxabs, std::fabs(src.sh[48 * g + i]));
+		for (int i = 0; i < 48; i++)
+		{
+			float a = dst.sh[48 * g + i], b = src.sh[48 * g + i];
+			sh_ok &= i < 3 ? nearHalf(a, b) : near(a, b, maxabs / 127.0f * 0.51f + std::fabs(b) / 1024.0f);
+		}
+	}
+	check(own_ok, "unpacked position, scale, rotation and opacity");
+	check(sh_ok, "unpacked SHs");
+	check(parent_ok, "unpacked parent values");
+}
+
+// Recursive expansion that the flat expandToTarget replaced
+static void referenceExpandToTarget(int node_id, const Node* nodes, int target, std::vector<int>& indices)
+{
+	const Node& node = nodes[node_id];
+	for (int i = 0; i < node.count_leafs; i++)
+		indices.push_back(node.start + i);
+
+	if (node.depth <= target)
+	{
+		for (int i = 0; i < node.count_merged; i++)
+			indices.push_back(node.start + node.count_leafs + i);
+	}
+	else
+	{
+		for (int i = 0; i < node.count_children; i++)
+			referenceExpandToTarget(node.start_children + i, nodes, target, indices);
+	}
+}
+
+// The flat expansion emits the same Gaussians in the same order as the
+// recursive one, for every depth and with interior nodes that hold leaf
+// Gaussians next to their merged ones
+static void checkTargetExpansion()
+{
+	SyntheticHierarchy h(9);
+	int N = h.size();
+	int num_gaussians = 0;
+	for (int id = 0; id < N; id++)
+	{
+		Node& node = h.nodes[id];
+		node.start = num_gaussians;
+		if (node.count_children != 0)
+			node.count_leafs = id % 2;
+		num_gaussians += node.count_leafs + node.count_merged;
+	}
+
+	std::vector<int> order;
+	Traversal::computeTraversalOrder(h.nodes.data(), order);
+	check((int)order.size() == N && order[0] == 0, "traversal order covers the hierarchy");
+
+	std::vector<int> counts(N), render_indices(num_gaussians);
+	bool flat_ok = true, vector_ok = true;
+	for (int target = -1; target <= 9; target++)
+	{
+		std::vector<int> expected;
+		referenceExpandToTarget(0, h.nodes.data(), target, expected);
+
+		int count = Traversal::expandToTarget(N, h.nodes.data(), order.data(), target, counts.data(), render_indices.data());
+		flat_ok &= count == (int)expected.size() && std::equal(expected.begin(), expected.end(), render_indices.begin());
+		vector_ok &= Traversal::expandToTarget(h.nodes.data(), target) == expected;
+	}
+	check(flat_ok, "flat target expansion equals the recursive one");
+	check(vector_ok, "vector target expansion equals the recursive one");
+}
+
+// computeTsIndexed written out with Traversal::computeSize
+static void referenceTs(const Node* nodes, const Box* boxes, int node_id, const Point& viewpoint, float target_size, float& t, int& kids)
+{
+	const Node& node = nodes[node_id];
+	if (node.parent == -1)
+	{
+		t = 1.0f;
+		kids = 1;
+		return;
+	}
+	kids = nodes[node.parent].count_children;
+
+	const Box& box = boxes[node_id];
+	Point point = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+	float parentsize = Traversal::computeSize(boxes[node.parent], point, viewpoint);
+	if (parentsize > 2.0f * target_size)
+	{
+		t = 1.0f;
+		return;
+	}
+
+	float size = Traversal::computeSize(box, point, viewpoint);
+	float start = std::max(0.5f * parentsize, size);
+	float diff = parentsize - start;
+	if (diff <= 0)
+		t = 1.0f;
+	else
+		t = std::max(1.0f - std::max(0.0f, target_size - start) / diff, 0.0f);
+}
+
+// The branch-free interpolation weights match the kernel's logic for nodes in
+// any order, with the viewpoint outside of all boxes and inside some of them
+static void checkInterpolationWeights()
+{
+	SyntheticHierarchy h(8);
+	int N = h.size();
+
+	// Smaller extents for some nodes, so that their interpolation starts at half the parent size
+	for (int id = 1; id < N; id += 3)
+		h.boxes[id].maxx[3] *= 0.6f;
+
+	// Every node, then each node again in reverse
+	std::vector<int> indices(2 * N);
+	for (int i = 0; i < N; i++)
+		indices[i] = indices[2 * N - 1 - i] = i;
+
+	std::vector<float> ts(indices.size());
+	std::vector<int> kids(indices.size());
+	Point viewpoints[] = { Point(37.3f, 0.5f, 4.0f), Point(100.0f, 2.0f, 0.5f), Point(-20.0f, -5.0f, 10.0f), Point(12.25f, 0.5f, 0.5f) };
+	float target_sizes[] = { 0.02f, 0.1f, 0.5f, 2.0f };
+
+	bool ts_ok = true, kids_ok = true;
+	int interpolated = 0;
+	for (const Point& viewpoint : viewpoints)
+	{
+		for (float target_size : target_sizes)
+		{
+			Traversal::getTsIndexed((int)indices.size(), indices.data(), target_size, h.nodes.data(), h.boxes.data(), viewpoint, ts.data(), kids.data());
+			for (int i = 0; i < (int)indices.size(); i++)
+			{
+				float t;
+				int k;
+				referenceTs(h.nodes.data(), h.boxes.data(), indices[i], viewpoint, target_size, t, k);
+				ts_ok &= near(ts[i], t, 1e-5f);
+				kids_ok &= kids[i] == k;
+				interpolated += t > 0.0f && t < 1.0f;
+			}
+		}
+	}
+	check(interpolated > 0, "some nodes are interpolated");
+	check(ts_ok, "interpolation weights equal the reference");
+	check(kids_ok, "sibling counts equal the reference");
+}
+
+// Without hysteresis the incremental update must give the cut of a rebuild
+// from scratch at every step of a camera path, small moves and jumps alike
+static void checkIncrementalUpdate()
+{
+	SyntheticHierarchy h(10);
+	int N = h.size();
+	float target_size = 0.1f;
+
+	IncrementalTraversal incremental(N, h.nodes.data(), h.boxes.data());
+	IncrementalTraversal reference(N, h.nodes.data(), h.boxes.data());
+	std::vector<int> render_indices(N), parent_indices(N), nodes_of_render_indices(N);
+	std::vector<int> expected(N), expected_parents(N), expected_nodes(N);
+
+	bool nodes_ok = true, indices_ok = true;
+	int changes = 0, min_count = N, max_count = 0;
+	for (int step = 0; step < 400; step++)
+	{
+		// Sweep along the tiled axis at a varying height, jumping every 50 steps
+		float x = -20.0f + 1.7f * step + (step % 50 == 49 ? 150.0f : 0.0f);
+		Point viewpoint(x, 0.5f + 0.3f * std::sin(0.1f * step), 1.0f + 2.0f * std::fabs(std::sin(0.05f * step)));
+		changes += incremental.update(viewpoint, target_size);
+		reference.rebuild(viewpoint, target_size);
+
+		nodes_ok &= incremental.activeNodes() == reference.activeNodes() && incremental.splitState() == reference.splitState();
+
+		int count = incremental.getRenderIndices(render_indices.data(), parent_indices.data(), nodes_of_render_indices.data());
+		int expected_count = reference.getRenderIndices(expected.data(), expected_parents.data(), expected_nodes.data());
+		indices_ok &= count == expected_count &&
+			std::equal(expected.begin(), expected.begin() + count, render_indices.begin()) &&
+			std::equal(expected_parents.begin(), expected_parents.begin() + count, parent_indices.begin()) &&
+			std::equal(expected_nodes.begin(), expected_nodes.begin() + count, nodes_of_render_indices.begin());
+		min_count = std::min(min_count, count);
+		max_count = std::max(max_count, count);
+	}
+	check(changes > 0 && min_count < max_count, "camera path changes the cut");
+	check(nodes_ok, "incremental active nodes and split state equal a rebuild");
+	check(indices_ok, "incremental render indices equal a rebuild");
+}
+
+// Checks of the CPU runtime paths on small synthetic hierarchies,
+// returns the number of failed checks
+int main(int argc, char* argv[])
+{
+	checkWorkspace();
+	checkCompaction();
+	checkPacking();
+	checkTargetExpansion();
+	checkInterpolationWeights();
+	checkIncrementalUpdate();
+
+	std::cout << (failures == 0 ? "All checks passed" : "Some checks failed") << std::endl;
+	return failures;
+}
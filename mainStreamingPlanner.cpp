@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "hierarchy_view.h"
+#include "streaming_planner.h"
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+// Plans which subtrees to prefetch by which frame for a known camera path.
+// The trajectory is a COLMAP folder or a text file with one "x y z" per line,
+// bandwidth is in MB/s and the memory budget in MB. The schedule is written
+// for playback at the nominal speed, one trajectory frame per displayed frame.
+int main(int argc, char* argv[])
+{
+	if (argc < 6)
+		throw std::runtime_error("Failed to pass args <hierarchy_file> <trajectory> <target_size> <bandwidth_MBps> <memory_MB> [fps] [schedule_file]");
+
+	auto view = HierarchyView::load(argv[1]);
+	std::vector<Point> path = StreamingPlanner::loadTrajectory(argv[2]);
+	if (path.empty())
+		throw std::runtime_error("Trajectory has no cameras");
+
+	float target_size = std::stof(argv[3]);
+	double fps = argc > 6 ? std::stod(argv[6]) : 30.0;
+	double bandwidth = std::stod(argv[4]) * 1024 * 1024 / fps;
+	size_t memory_budget = (size_t)(std::stod(argv[5]) * 1024 * 1024);
+
+	StreamingPlanner planner(view);
+	planner.simulate(path, target_size);
+
+	std::vector<PrefetchEntry> entries;
+	double stall_frames = 0;
+	int late = planner.schedule(1.0f, bandwidth, memory_budget, &entries, &stall_frames);
+	float max_speed = planner.maxStallFreeSpeed(bandwidth, memory_budget);
+
+	std::cout << "Frames: " << planner.numFrames() << std::endl;
+	std::cout << "Loads: " << planner.numLoads() << " (" << planner.totalBytes() / (1024 * 1024) << " MB)" << std::endl;
+	std::cout << "Peak working set: " << planner.peakWorkingSet() / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Preload: " << planner.preloadFrames(bandwidth) / fps << " s" << std::endl;
+	std::cout << "Late loads at nominal speed: " << late << " (" << stall_frames / fps << " s behind in total)" << std::endl;
+	if (max_speed == 0)
+		std::cout << "No stall-free speed within the memory budget" << std::endl;
+	else
+		std::cout << "Max stall-free speed: " << max_speed << "x nominal" << std::endl;
+
+	if (argc > 7)
+	{
+		if (!StreamingPlanner::writeSchedule(argv[7], entries))
+			throw std::runtime_error("Could not write schedule");
+		std::cout << "Schedule written to " << argv[7] << std::endl;
+	}
+
+	return 0;
+}
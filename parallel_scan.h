@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MAX_SCAN_THREADS 256
+
+// CPU counterpart of cub::DeviceScan::InclusiveSum. Each thread scans its own
+// contiguous chunk, the chunk totals are scanned and added back in a second
+// sweep. Works in-place (in == out) and returns the total.
+template <typename T>
+T inclusiveSum(const T* in, T* out, int N)
+{
+	if (N <= 0)
+		return 0;
+
+#ifdef _OPENMP
+	T partial[MAX_SCAN_THREADS + 1];
+	partial[0] = 0;
+
+	int num_threads = std::min(omp_get_max_threads(), MAX_SCAN_THREADS);
+	if (N < 4096)
+		num_threads = 1;
+
+#pragma omp parallel num_threads(num_threads)
+	{
+		int nt = omp_get_num_threads();
+		int tid = omp_get_thread_num();
+		int chunk = (N + nt - 1) / nt;
+		int begin = std::min(N, tid * chunk);
+		int end = std::min(N, begin + chunk);
+
+		T sum = 0;
+		for (int i = begin; i < end; i++)
+		{
+			sum += in[i];
+			out[i] = sum;
+		}
+		partial[tid + 1] = sum;
+
+#pragma omp barrier
+#pragma omp single
+		for (int i = 1; i <= nt; i++)
+			partial[i] += partial[i - 1];
+
+		T offset = partial[tid];
+		if (offset != 0)
+			for (int i = begin; i < end; i++)
+				out[i] += offset;
+	}
+#else
+	T sum = 0;
+	for (int i = 0; i < N; i++)
+	{
+		sum += in[i];
+		out[i] = sum;
+	}
+#endif
+	return out[N - 1];
+}
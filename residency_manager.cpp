@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "residency_manager.h"
+#include "runtime_maintenance_cpu.h"
+#include "traversal.h"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+
+// Per node bookkeeping shared by both buffers: removed flags, kept and new
+// kept lists, the four compaction scans, the remapping and the store id
+// lookup of prefetch() with its mapped ids and chained remapping
+static const size_t BOOKKEEPING_BYTES = sizeof(char) + 11 * sizeof(int);
+
+size_t ResidencyManager::bytesPerNode()
+{
+	return sizeof(Node) + sizeof(Box) + 3 * sizeof(int); // + split, cuda2cpu, last_use
+}
+
+size_t ResidencyManager::bytesPerGaussian()
+{
+	return (3 + 4 + 48 + 1 + 3) * sizeof(float);
+}
+
+void ResidencyManager::Buffers::allocate(int max_nodes, int max_gaussians)
+{
+	nodes.resize(max_nodes);
+	boxes.resize(max_nodes);
+	split.resize(max_nodes);
+	cuda2cpu.resize(max_nodes);
+	last_use.resize(max_nodes);
+	pos.resize(3 * (size_t)max_gaussians);
+	rot.resize(4 * (size_t)max_gaussians);
+	sh.resize(48 * (size_t)max_gaussians);
+	alpha.resize(max_gaussians);
+	scale.resize(3 * (size_t)max_gaussians);
+}
+
+ResidencyManager::ResidencyManager(std::shared_ptr<const HierarchyView> store, size_t budget_bytes) :
+	store(std::move(store))
+{
+	// Nodes hold at least one Gaussian in practice, so both get the same capacity
+	size_t per_slot = 2 * (bytesPerNode() + bytesPerGaussian()) + BOOKKEEPING_BYTES;
+	size_t slots = std::min(budget_bytes / per_slot, (size_t)INT32_MAX);
+	max_nodes = (int)slots;
+	max_gaussians = (int)slots;
+
+	if (this->store->numNodes() == 0)
+		throw std::runtime_error("Residency manager needs a non-empty hierarchy");
+
+	const Node& root = this->store->nodes()[0];
+	if (max_nodes < 1 || root.count_leafs + root.count_merged > max_gaussians)
+		throw std::runtime_error("Residency budget is too small for the hierarchy root");
+
+	front.allocate(max_nodes, max_gaussians);
+	back.allocate(max_nodes, max_gaussians);
+	removed.resize(max_nodes);
+	kept.resize(max_nodes);
+	new_kept.resize(max_nodes);
+	src_counts.resize(max_nodes);
+	src_counts2.resize(max_nodes);
+	dst_offsets.resize(max_nodes);
+	dst_offsets2.resize(max_nodes);
+	remapping.reserve(max_nodes);
+	store_to_working.reserve(max_nodes);
+	working_ids.reserve(max_nodes);
+	prefetch_remap.reserve(max_nodes);
+
+	// The root is always resident, it is working set node 0
+	Node node = root;
+	node.parent = -1;
+	node.start_children = -1;
+	node.start = 0;
+	front.nodes[0] = node;
+	front.boxes[0] = this->store->boxes()[0];
+	front.split[0] = 0;
+	front.cuda2cpu[0] = 0;
+	front.last_use[0] = 0;
+	num_nodes = 1;
+
+	const HierarchyView& view = *this->store;
+	for (int i = 0; i < root.count_leafs + root.count_merged; i++)
+	{
+		int src = root.start + i;
+		std::memcpy(&front.pos[3 * i], view.positions()[src].data(), sizeof(float) * 3);
+		std::memcpy(&front.rot[4 * i], view.rotations()[src].data(), sizeof(float) * 4);
+		std::memcpy(&front.sh[48 * i], view.shs()[src].data(), sizeof(float) * 48);
+		front.alpha[i] = view.alphas()[src];
+		std::memcpy(&front.scale[3 * i], view.scales()[src].data(), sizeof(float) * 3);
+	}
+	num_gaussians = root.count_leafs + root.count_merged;
+}
+
+void ResidencyManager::touch(const int* nodes, int count, int frame)
+{
+	for (int i = 0; i < count; i++)
+		if (nodes[i] >= 0 && nodes[i] < num_nodes)
+			front.last_use[nodes[i]] = std::max(front.last_use[nodes[i]], frame);
+}
+
+int ResidencyManager::groupGaussians(int store_node) const
+{
+	const Node* nodes = store->nodes();
+	const Node& node = nodes[store_node];
+
+	int count = 0;
+	for (int i = 0; i < node.count_children; i++)
+	{
+		const Node& child = nodes[node.start_children + i];
+		count += child.count_leafs + child.count_merged;
+	}
+	return count;
+}
+
+bool ResidencyManager::isLeafGroup(int node_id) const
+{
+	if (front.split[node_id] == 0)
+		return false;
+
+	const Node& node = front.nodes[node_id];
+	for (int i = 0; i < node.count_children; i++)
+		if (front.split[node.start_children + i])
+			return false;
+	return true;
+}
+
+int ResidencyManager::groupLastUse(int node_id) const
+{
+	const Node& node = front.nodes[node_id];
+
+	int last_use = front.last_use[node_id];
+	for (int i = 0; i < node.count_children; i++)
+		last_use = std::max(last_use, front.last_use[node.start_children + i]);
+	return last_use;
+}
+
+void ResidencyManager::evict(int need_nodes, int need_gaussians, const Point& viewpoint, int frame)
+{
+	auto victim = [&](int node_id) {
+		const Box& box = front.boxes[node_id];
+		Point center = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		return Victim{ groupLastUse(node_id), Traversal::computeSize(box, center, viewpoint), node_id };
+	};
+
+	std::priority_queue<Victim> heap;
+	for (int node_id = 0; node_id < num_nodes; node_id++)
+	{
+		if (!isLeafGroup(node_id))
+			continue;
+		Victim v = victim(node_id);
+		if (v.last_use < frame)
+			heap.push(v);
+	}
+
+	int free_nodes = max_nodes - num_nodes;
+	int free_gaussians = max_gaussians - num_gaussians;
+	while ((free_nodes < need_nodes || free_gaussians < need_gaussians) && !heap.empty())
+	{
+		Victim v = heap.top();
+		heap.pop();
+
+		const Node& node = front.nodes[v.node_id];
+		for (int i = 0; i < node.count_children; i++)
+		{
+			const Node& child = front.nodes[node.start_children + i];
+			removed[node.start_children + i] = 1;
+			free_gaussians += child.count_leafs + child.count_merged;
+		}
+		free_nodes += node.count_children;
+		front.split[v.node_id] = 0;
+		front.last_use[v.node_id] = std::max(front.last_use[v.node_id], v.last_use);
+		num_evictions++;
+
+		// Evicting the last resident grandchildren turns the parent group into a candidate
+		if (node.parent != -1 && isLeafGroup(node.parent))
+		{
+			Victim parent = victim(node.parent);
+			if (parent.last_use < frame)
+				heap.push(parent);
+		}
+	}
+}
+
+void ResidencyManager::compact()
+{
+	int N = 0;
+	for (int node_id = 0; node_id < num_nodes; node_id++)
+		if (!removed[node_id])
+			kept[N++] = node_id;
+
+	char* scratch = nullptr;
+	size_t scratch_size = 0;
+	int node_count, gaussian_count;
+
+	MaintenanceCPU::compactPart1(
+		num_nodes, N,
+		kept.data(), new_kept.data(),
+		(int*)front.nodes.data(), (float*)front.boxes.data(),
+		front.pos.data(), front.rot.data(), front.sh.data(), front.alpha.data(), front.scale.data(),
+		front.split.data(),
+		(int*)back.nodes.data(), (float*)back.boxes.data(),
+		back.pos.data(), back.rot.data(), back.sh.data(), back.alpha.data(), back.scale.data(),
+		back.split.data(),
+		front.cuda2cpu.data(), back.cuda2cpu.data(),
+		src_counts.data(), src_counts2.data(), dst_offsets.data(), dst_offsets2.data(),
+		scratch, scratch_size, nullptr, &node_count);
+
+	MaintenanceCPU::compactPart2(
+		num_nodes, N,
+		kept.data(), new_kept.data(),
+		(int*)front.nodes.data(), (float*)front.boxes.data(),
+		front.pos.data(), front.rot.data(), front.sh.data(), front.alpha.data(), front.scale.data(),
+		front.split.data(),
+		(int*)back.nodes.data(), (float*)back.boxes.data(),
+		back.pos.data(), back.rot.data(), back.sh.data(), back.alpha.data(), back.scale.data(),
+		back.split.data(),
+		front.cuda2cpu.data(), back.cuda2cpu.data(),
+		src_counts.data(), src_counts2.data(), dst_offsets.data(), dst_offsets2.data(),
+		scratch, scratch_size, nullptr, &gaussian_count);
+
+	// Kept nodes have a source count of one, the inclusive scan minus one is their new id
+	remapping.resize(num_nodes);
+	for (int node_id = 0; node_id < num_nodes; node_id++)
+	{
+		if (removed[node_id])
+		{
+			remapping[node_id] = -1;
+			removed[node_id] = 0;
+		}
+		else
+		{
+			remapping[node_id] = dst_offsets[node_id] - 1;
+			back.last_use[remapping[node_id]] = front.last_use[node_id];
+		}
+	}
+
+	std::swap(front, back);
+	num_nodes = node_count;
+	num_gaussians = gaussian_count;
+	was_compacted = true;
+}
+
+void ResidencyManager::load(int node_id)
+{
+	const HierarchyView& view = *store;
+	Node& parent = front.nodes[node_id];
+	const Node& src = view.nodes()[front.cuda2cpu[node_id]];
+
+	parent.start_children = num_nodes;
+	front.split[node_id] = 1;
+
+	for (int i = 0; i < src.count_children; i++)
+	{
+		int store_id = src.start_children + i;
+		Node node = view.nodes()[store_id];
+		int count = node.count_leafs + node.count_merged;
+
+		for (int j = 0; j < count; j++)
+		{
+			int g = num_gaussians + j;
+			int s = node.start + j;
+			std::memcpy(&front.pos[3 * (size_t)g], view.positions()[s].data(), sizeof(float) * 3);
+			std::memcpy(&front.rot[4 * (size_t)g], view.rotations()[s].data(), sizeof(float) * 4);
+			std::memcpy(&front.sh[48 * (size_t)g], view.shs()[s].data(), sizeof(float) * 48);
+			front.alpha[g] = view.alphas()[s];
+			std::memcpy(&front.scale[3 * (size_t)g], view.scales()[s].data(), sizeof(float) * 3);
+		}
+
+		node.parent = node_id;
+		node.start = num_gaussians;
+		node.start_children = -1;
+		front.nodes[num_nodes] = node;
+		front.boxes[num_nodes] = view.boxes()[store_id];
+		front.split[num_nodes] = 0;
+		front.cuda2cpu[num_nodes] = store_id;
+		front.last_use[num_nodes] = front.last_use[node_id];
+
+		num_nodes++;
+		num_gaussians += count;
+	}
+	num_loads++;
+}
+
+int ResidencyManager::expand(const int* nodes_to_expand, int count, const Point& viewpoint, int frame)
+{
+	struct Request
+	{
+		float size;
+		int node_id;
+		int nodes;
+		int gaussians;
+	};
+
+	was_compacted = false;
+	remapping.clear();
+
+	const Node* store_nodes = store->nodes();
+	std::vector<Request> requests;
+	for (int i = 0; i < count; i++)
+	{
+		int node_id = nodes_to_expand[i];
+		if (node_id < 0 || node_id >= num_nodes || front.split[node_id])
+			continue;
+
+		const Node& src = store_nodes[front.cuda2cpu[node_id]];
+		if (src.count_children == 0 || src.start_children == -1)
+			continue;
+
+		// Requested nodes are in use, their group must survive the eviction
+		front.last_use[node_id] = std::max(front.last_use[node_id], frame);
+
+		const Box& box = front.boxes[node_id];
+		Point center = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		requests.push_back({ Traversal::computeSize(box, center, viewpoint), node_id, src.count_children, groupGaussians(front.cuda2cpu[node_id]) });
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.node_id < b.node_id; });
+	requests.erase(std::unique(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.node_id == b.node_id; }), requests.end());
+	std::stable_sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.size > b.size; });
+
+	int need_nodes = 0, need_gaussians = 0;
+	for (const Request& r : requests)
+	{
+		need_nodes += r.nodes;
+		need_gaussians += r.gaussians;
+	}
+
+	if (num_nodes + need_nodes > max_nodes || num_gaussians + need_gaussians > max_gaussians)
+	{
+		size_t evicted = num_evictions;
+		evict(need_nodes, need_gaussians, viewpoint, frame);
+		if (num_evictions != evicted)
+		{
+			compact();
+			for (Request& r : requests)
+				r.node_id = remapping[r.node_id];
+		}
+	}
+
+	int expanded = 0;
+	for (const Request& r : requests)
+	{
+		if (num_nodes + r.nodes > max_nodes || num_gaussians + r.gaussians > max_gaussians)
+		{
+			num_deferred++;
+			continue;
+		}
+		load(r.node_id);
+		expanded++;
+	}
+	return expanded;
+}
+
+int ResidencyManager::prefetch(const int* store_nodes, int count, const Point& viewpoint, int frame)
+{
+	pending.assign(store_nodes, store_nodes + count);
+	bool any_compacted = false;
+	int expanded = 0;
+
+	while (!pending.empty())
+	{
+		store_to_working.resize(num_nodes);
+		for (int node_id = 0; node_id < num_nodes; node_id++)
+			store_to_working[node_id] = std::make_pair(front.cuda2cpu[node_id], node_id);
+		std::sort(store_to_working.begin(), store_to_working.end());
+
+		working_ids.clear();
+		size_t kept = 0;
+		for (int store_id : pending)
+		{
+			auto it = std::lower_bound(store_to_working.begin(), store_to_working.end(), std::make_pair(store_id, -1));
+			if (it != store_to_working.end() && it->first == store_id)
+				working_ids.push_back(it->second);
+			else
+				pending[kept++] = store_id;
+		}
+		pending.resize(kept);
+		if (working_ids.empty())
+			break;
+
+		expanded += expand(working_ids.data(), (int)working_ids.size(), viewpoint, frame);
+
+		// Chain the remappings, callers see one from the ids before this call
+		if (was_compacted)
+		{
+			if (!any_compacted)
+				prefetch_remap = remapping;
+			else
+				for (int& node_id : prefetch_remap)
+					node_id = node_id == -1 ? -1 : remapping[node_id];
+			any_compacted = true;
+		}
+	}
+
+	was_compacted = any_compacted;
+	if (any_compacted)
+		remapping.swap(prefetch_remap);
+	else
+		remapping.clear();
+	return expanded;
+}
+
+size_t ResidencyManager::residentBytes() const
+{
+	return num_nodes * bytesPerNode() + num_gaussians * bytesPerGaussian();
+}
+
+size_t ResidencyManager::allocatedBytes() const
+{
+	return 2 * (max_nodes * bytesPerNode() + max_gaussians * bytesPerGaussian()) + max_nodes * BOOKKEEPING_BYTES;
+}
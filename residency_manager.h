@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "common.h"
+#include "hierarchy_view.h"
+
+// Keeps a bounded working set of a hierarchy resident on the host. The
+// working set starts with the root; traversals over it report nodes whose
+// children are missing (start_children == -1) and expand() copies those
+// children from the backing store. Working set nodes map back to the store
+// through cuda2cpu(), split() marks nodes whose children are resident.
+//
+// Both working set buffers (the live one and the compaction target) are
+// allocated once from the budget, so memory never grows with the scene.
+// When an expansion does not fit, groups of children whose own children are
+// not resident are evicted, least recently used first and smallest screen
+// size among equally old ones, then the working set is compacted with
+// MaintenanceCPU. Nodes touched in the current frame are never evicted.
+class ResidencyManager
+{
+public:
+	ResidencyManager(std::shared_ptr<const HierarchyView> store, size_t budget_bytes);
+
+	// Marks working set nodes as used in this frame, e.g. the active nodes of the cut
+	void touch(const int* nodes, int count, int frame);
+
+	// Loads the children of the given working set nodes, largest screen size
+	// first. Returns the number of nodes expanded, requests that do not fit
+	// even after eviction are dropped and counted as deferred.
+	int expand(const int* nodes_to_expand, int count, const Point& viewpoint, int frame);
+
+	// Same as expand() for nodes given by their store ids, e.g. the loads of
+	// SubtreePrefetcher. Nodes are mapped to the working set through cuda2cpu;
+	// nodes that become resident through an earlier one in the list are
+	// expanded in a further round, so parents first chains load in one call.
+	// Nodes that are still not resident then are dropped. remap() covers all rounds.
+	int prefetch(const int* store_nodes, int count, const Point& viewpoint, int frame);
+
+	// Whether the last expand() compacted the working set, and the mapping
+	// from the previous working set ids to the new ones (-1 for evicted nodes)
+	bool compacted() const { return was_compacted; }
+	const std::vector<int>& remap() const { return remapping; }
+
+	int numNodes() const { return num_nodes; }
+	int numGaussians() const { return num_gaussians; }
+	int nodeCapacity() const { return max_nodes; }
+	int gaussianCapacity() const { return max_gaussians; }
+
+	Node* nodes() { return front.nodes.data(); }
+	Box* boxes() { return front.boxes.data(); }
+	float* positions() { return front.pos.data(); }
+	float* rotations() { return front.rot.data(); }
+	float* shs() { return front.sh.data(); }
+	float* alphas() { return front.alpha.data(); }
+	float* scales() { return front.scale.data(); }
+	int* split() { return front.split.data(); }
+	int* cuda2cpu() { return front.cuda2cpu.data(); }
+
+	// Bytes of the working set that hold data, the allocation itself stays within the budget
+	size_t residentBytes() const;
+	size_t allocatedBytes() const;
+
+	size_t loads() const { return num_loads; }
+	size_t evictions() const { return num_evictions; }
+	size_t deferred() const { return num_deferred; }
+
+	static size_t bytesPerNode();
+	static size_t bytesPerGaussian();
+
+private:
+
+	struct Buffers
+	{
+		std::vector<Node> nodes;
+		std::vector<Box> boxes;
+		std::vector<float> pos, rot, sh, alpha, scale;
+		std::vector<int> split, cuda2cpu, last_use;
+
+		void allocate(int max_nodes, int max_gaussians);
+	};
+
+	struct Victim
+	{
+		int last_use;
+		float size;
+		int node_id;
+
+		// Max-heap order puts the oldest, then smallest node on top
+		bool operator<(const Victim& other) const
+		{
+			if (last_use != other.last_use)
+				return last_use > other.last_use;
+			return size > other.size;
+		}
+	};
+
+	int groupGaussians(int store_node) const;
+	bool isLeafGroup(int node_id) const;
+	int groupLastUse(int node_id) const;
+	void evict(int need_nodes, int need_gaussians, const Point& viewpoint, int frame);
+	void compact();
+	void load(int node_id);
+
+	std::shared_ptr<const HierarchyView> store;
+
+	int max_nodes;
+	int max_gaussians;
+	int num_nodes = 0;
+	int num_gaussians = 0;
+
+	Buffers front, back;
+	std::vector<char> removed;
+	std::vector<int> kept, new_kept, src_counts, src_counts2, dst_offsets, dst_offsets2;
+	std::vector<int> remapping;
+	std::vector<int> pending, working_ids, prefetch_remap;
+	std::vector<std::pair<int, int>> store_to_working;
+	bool was_compacted = false;
+
+	size_t num_loads = 0;
+	size_t num_evictions = 0;
+	size_t num_deferred = 0;
+};
@@ -11,6 +11,7 @@
 
 
 #include "cuda_runtime.h"
+#include <cuda_fp16.h>
 #include "device_launch_parameters.h"
 #include <cub/cub.cuh>
 #include <cub/device/device_radix_sort.cuh>
@@ -296,6 +297,110 @@ void Maintenance::compress(
 		);
 }
 
+__device__ unsigned short toHalfBits(float v)
+{
+	return __half_as_ushort(__float2half_rn(v));
+}
+
+__global__ void packCUDA(
+	int N,
+	const Node* nodes,
+	const float3* positions,
+	const float4* rots,
+	const float* shs,
+	const float* opacities,
+	const float3* scales,
+	PackedGaussian* packed
+)
+{
+	int idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= N)
+		return;
+
+	Node node = nodes[idx];
+
+	int parent = node.start;
+	if (node.parent != -1)
+	{
+		parent = nodes[node.parent].start;
+	}
+
+	// Reads only the float spaces, so unlike compress there is no race with the parent
+	for (int g = node.start; g < node.start + node.count_leafs + node.count_merged; g++)
+	{
+		PackedGaussian p;
+
+		float3 pos = positions[g];
+		p.position[0] = pos.x;
+		p.position[1] = pos.y;
+		p.position[2] = pos.z;
+
+		const float* scale = (const float*)&scales[g];
+		const float* pscale = (const float*)&scales[parent];
+		const float* rot = (const float*)&rots[g];
+		const float* prot = (const float*)&rots[parent];
+		for (int i = 0; i < 3; i++)
+		{
+			p.scale[i][0] = toHalfBits(scale[i]);
+			p.scale[i][1] = toHalfBits(pscale[i]);
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			p.rotation[0][i] = toHalfBits(rot[i]);
+			p.rotation[1][i] = toHalfBits(prot[i]);
+		}
+		p.opacity[0] = toHalfBits(opacities[g]);
+		p.opacity[1] = toHalfBits(opacities[parent]);
+
+		const float* sh = shs + 48 * g;
+		for (int i = 0; i < 3; i++)
+			p.sh_dc[i] = toHalfBits(sh[i]);
+
+		float maxabs = 0;
+		for (int i = 3; i < 48; i++)
+			maxabs = fmaxf(maxabs, fabsf(sh[i]));
+
+		// Quantize against the rounded scale the decoder will see
+		__half step = __float2half_rn(maxabs / 127.0f);
+		float fstep = __half2float(step);
+		p.sh_scale = __half_as_ushort(step);
+		for (int i = 0; i < 45; i++)
+		{
+			float q = fstep > 0 ? rintf(sh[3 + i] / fstep) : 0;
+			p.sh_rest[i] = (signed char)fminf(fmaxf(q, -127.0f), 127.0f);
+		}
+		p.padding[0] = p.padding[1] = p.padding[2] = 0;
+
+		packed[g] = p;
+	}
+}
+
+void Maintenance::pack(
+	int N,
+	const int* nodes,
+	const float* pos_space,
+	const float* rot_space,
+	const float* sh_space,
+	const float* alpha_space,
+	const float* scale_space,
+	char* packed_space,
+	void* streamy
+)
+{
+	cudaStream_t stream = (cudaStream_t)streamy;
+
+	int num_blocks = (N + 255) / 256;
+	packCUDA << <num_blocks, 256, 0, stream >> > (N,
+		(const Node*)nodes,
+		(const float3*)pos_space,
+		(const float4*)rot_space,
+		sh_space,
+		alpha_space,
+		(const float3*)scale_space,
+		(PackedGaussian*)packed_space
+		);
+}
+
 void Maintenance::compactPart2(
 	int topN,
 	int N,
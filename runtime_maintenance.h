@@ -54,6 +54,21 @@ public:
 		float* opacs
 	);
 
+	// Packs the Gaussians of the N nodes into PackedGaussian records at their
+	// own index, together with the values of the parent node's first Gaussian.
+	// The float spaces are left untouched.
+	static void pack(
+		int N,
+		const int* nodes,
+		const float* pos_space,
+		const float* rot_space,
+		const float* sh_space,
+		const float* alpha_space,
+		const float* scale_space,
+		char* packed_space,
+		void* streamy
+	);
+
 	static void compactPart1(
 		int topN,
 		int N,
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "runtime_maintenance_cpu.h"
+#include "types.h"
+#include "parallel_scan.h"
+#include "half.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static int safeexc(const int* data, int index)
+{
+	if (index == 0)
+		return 0;
+	return data[index - 1];
+}
+
+void MaintenanceCPU::reorder(
+	int N,
+	int* active_nodes,
+	int* new_active_nodes,
+	const int* nodes,
+	const float* boxes,
+	const float* pos_space,
+	const float* rot_space,
+	const float* sh_space,
+	const float* alpha_space,
+	const float* scale_space,
+	int* split_space,
+	int* new_nodes,
+	float* new_boxes,
+	float* new_pos_space,
+	float* new_rot_space,
+	float* new_sh_space,
+	float* new_alpha_space,
+	float* new_scale_space,
+	int* new_split_space,
+	int* cuda2cpu_src,
+	int* cuda2cpu_dst,
+	int* node_indices,
+	int* gaussian_indices,
+	void* streamy
+)
+{
+	const Node* src_nodes = (const Node*)nodes;
+	const Box* src_boxes = (const Box*)boxes;
+	Node* dst_nodes = (Node*)new_nodes;
+	Box* dst_boxes = (Box*)new_boxes;
+
+	// One node per iteration does the work of all 15 roles of the rearrange kernel
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int idx = 0; idx < N; idx++)
+	{
+		int node_id = active_nodes[idx];
+		int target_id = safeexc(node_indices, node_id);
+
+		Node node = src_nodes[node_id];
+
+		dst_boxes[target_id] = src_boxes[node_id];
+		new_split_space[target_id] = split_space[node_id];
+
+		if (split_space[node_id] == 0) // Every unexpanded node is gone
+			node.start_children = -1;
+		split_space[node_id] = 0; // Clean up after yourself
+
+		node.parent = node.parent == -1 ? -1 : safeexc(node_indices, node.parent);
+		node.start_children = node.start_children == -1 ? -1 : safeexc(node_indices, node.start_children);
+
+		int new_start = safeexc(gaussian_indices, node_id);
+		int count = node.count_leafs + node.count_merged;
+		int src = node.start;
+		std::memcpy(new_pos_space + 3 * new_start, pos_space + 3 * src, sizeof(float) * 3 * count);
+		std::memcpy(new_rot_space + 4 * new_start, rot_space + 4 * src, sizeof(float) * 4 * count);
+		std::memcpy(new_sh_space + 48 * new_start, sh_space + 48 * src, sizeof(float) * 48 * count);
+		std::memcpy(new_alpha_space + new_start, alpha_space + src, sizeof(float) * count);
+		std::memcpy(new_scale_space + 3 * new_start, scale_space + 3 * src, sizeof(float) * 3 * count);
+
+		node.start = new_start;
+		dst_nodes[target_id] = node;
+		new_active_nodes[idx] = idx;
+		cuda2cpu_dst[target_id] = cuda2cpu_src[node_id];
+	}
+}
+
+void MaintenanceCPU::compactPart1(
+	int topN,
+	int N,
+	int* active_nodes,
+	int* new_active_nodes,
+	const int* nodes,
+	const float* boxes,
+	const float* pos_space,
+	const float* rot_space,
+	const float* sh_space,
+	const float* alpha_space,
+	const float* scale_space,
+	int* split_space,
+	int* new_nodes,
+	float* new_boxes,
+	float* new_pos_space,
+	float* new_rot_space,
+	float* new_sh_space,
+	float* new_alpha_space,
+	float* new_scale_space,
+	int* new_split_space,
+	int* cuda2cpu_src,
+	int* cuda2cpu_dst,
+	int* NsrcI,
+	int* NsrcI2,
+	int* NdstI,
+	int* NdstI2,
+	char*& scratchspace,
+	size_t& scratchspacesize,
+	void* streamy,
+	int* count
+)
+{
+	const Node* src_nodes = (const Node*)nodes;
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < topN; idx++)
+	{
+		NsrcI[idx] = 0;
+		NsrcI2[idx] = 0;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		int node_id = active_nodes[idx];
+		const Node& node = src_nodes[node_id];
+		NsrcI[node_id] = 1;
+		NsrcI2[node_id] = node.count_merged + node.count_leafs;
+	}
+
+	*count = inclusiveSum(NsrcI, NdstI, topN);
+}
+
+void MaintenanceCPU::compactPart2(
+	int topN,
+	int N,
+	int* active_nodes,
+	int* new_active_nodes,
+	const int* nodes,
+	const float* boxes,
+	const float* pos_space,
+	const float* rot_space,
+	const float* sh_space,
+	const float* alpha_space,
+	const float* scale_space,
+	int* split_space,
+	int* new_nodes,
+	float* new_boxes,
+	float* new_pos_space,
+	float* new_rot_space,
+	float* new_sh_space,
+	float* new_alpha_space,
+	float* new_scale_space,
+	int* new_split_space,
+	int* cuda2cpu_src,
+	int* cuda2cpu_dst,
+	int* NsrcI,
+	int* NsrcI2,
+	int* NdstI,
+	int* NdstI2,
+	char*& scratchspace,
+	size_t& scratchspacesize,
+	void* streamy,
+	int* count
+)
+{
+	*count = inclusiveSum(NsrcI2, NdstI2, topN);
+
+	reorder(
+		N,
+		active_nodes,
+		new_active_nodes,
+		nodes,
+		boxes,
+		pos_space,
+		rot_space,
+		sh_space,
+		alpha_space,
+		scale_space,
+		split_space,
+		new_nodes,
+		new_boxes,
+		new_pos_space,
+		new_rot_space,
+		new_sh_space,
+		new_alpha_space,
+		new_scale_space,
+		new_split_space,
+		cuda2cpu_src,
+		cuda2cpu_dst,
+		NdstI,
+		NdstI2,
+		streamy
+	);
+}
+
+void MaintenanceCPU::compress(
+	int N,
+	int* nodes,
+	float* scales,
+	float* rots,
+	float* shs,
+	float* opacs
+)
+{
+	const Node* src_nodes = (const Node*)nodes;
+
+	// Same packing as compressCUDA: each scale component becomes a half2 of the
+	// own value (low half) and the parent's value (high half). Parents are read
+	// before they may be overwritten, so the parent values are gathered first.
+	std::vector<float> parent_scales(3 * (size_t)N);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Node& node = src_nodes[idx];
+		int parent = node.parent == -1 ? node.start : src_nodes[node.parent].start;
+		for (int i = 0; i < 3; i++)
+			parent_scales[3 * idx + i] = scales[3 * parent + i];
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		float* scale = scales + 3 * src_nodes[idx].start;
+		for (int i = 0; i < 3; i++)
+		{
+			half_float::half mp[2] = { half_float::half(scale[i]), half_float::half(parent_scales[3 * idx + i]) };
+			std::memcpy(&scale[i], mp, sizeof(float)); // We are overwriting ourselves
+		}
+	}
+}
+
+static unsigned short toHalfBits(float v)
+{
+	half_float::half h(v);
+	unsigned short bits;
+	std::memcpy(&bits, &h, sizeof(bits));
+	return bits;
+}
+
+static float fromHalfBits(unsigned short bits)
+{
+	return half_float::detail::half2float<float>(bits);
+}
+
+void MaintenanceCPU::pack(
+	int N,
+	const int* nodes,
+	const float* pos_space,
+	const float* rot_space,
+	const float* sh_space,
+	const float* alpha_space,
+	const float* scale_space,
+	char* packed_space,
+	void* streamy
+)
+{
+	const Node* src_nodes = (const Node*)nodes;
+	PackedGaussian* packed = (PackedGaussian*)packed_space;
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Node& node = src_nodes[idx];
+		int parent = node.parent == -1 ? node.start : src_nodes[node.parent].start;
+
+		for (int g = node.start; g < node.start + node.count_leafs + node.count_merged; g++)
+		{
+			PackedGaussian p;
+			std::memcpy(p.position, pos_space + 3 * (size_t)g, sizeof(float) * 3);
+
+			for (int i = 0; i < 3; i++)
+			{
+				p.scale[i][0] = toHalfBits(scale_space[3 * (size_t)g + i]);
+				p.scale[i][1] = toHalfBits(scale_space[3 * (size_t)parent + i]);
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				p.rotation[0][i] = toHalfBits(rot_space[4 * (size_t)g + i]);
+				p.rotation[1][i] = toHalfBits(rot_space[4 * (size_t)parent + i]);
+			}
+			p.opacity[0] = toHalfBits(alpha_space[g]);
+			p.opacity[1] = toHalfBits(alpha_space[parent]);
+
+			const float* sh = sh_space + 48 * (size_t)g;
+			for (int i = 0; i < 3; i++)
+				p.sh_dc[i] = toHalfBits(sh[i]);
+
+			float maxabs = 0;
+			for (int i = 3; i < 48; i++)
+				maxabs = std::max(maxabs, std::fabs(sh[i]));
+
+			// Quantize against the rounded scale the decoder will see
+			p.sh_scale = toHalfBits(maxabs / 127.0f);
+			float step = fromHalfBits(p.sh_scale);
+			for (int i = 0; i < 45; i++)
+			{
+				float q = step > 0 ? std::nearbyint(sh[3 + i] / step) : 0;
+				p.sh_rest[i] = (signed char)std::min(std::max(q, -127.0f), 127.0f);
+			}
+			p.padding[0] = p.padding[1] = p.padding[2] = 0;
+
+			packed[g] = p;
+		}
+	}
+}
+
+void MaintenanceCPU::unpack(
+	int num_gaussians,
+	const char* packed_space,
+	float* pos_space,
+	float* rot_space,
+	float* sh_space,
+	float* alpha_space,
+	float* scale_space,
+	float* parent_rot_space,
+	float* parent_alpha_space,
+	float* parent_scale_space
+)
+{
+	const PackedGaussian* packed = (const PackedGaussian*)packed_space;
+
+#pragma omp parallel for schedule(static)
+	for (int g = 0; g < num_gaussians; g++)
+	{
+		const PackedGaussian& p = packed[g];
+		std::memcpy(pos_space + 3 * (size_t)g, p.position, sizeof(float) * 3);
+
+		for (int i = 0; i < 3; i++)
+			scale_space[3 * (size_t)g + i] = fromHalfBits(p.scale[i][0]);
+		for (int i = 0; i < 4; i++)
+			rot_space[4 * (size_t)g + i] = fromHalfBits(p.rotation[0][i]);
+		alpha_space[g] = fromHalfBits(p.opacity[0]);
+
+		float* sh = sh_space + 48 * (size_t)g;
+		for (int i = 0; i < 3; i++)
+			sh[i] = fromHalfBits(p.sh_dc[i]);
+		float step = fromHalfBits(p.sh_scale);
+		for (int i = 0; i < 45; i++)
+			sh[3 + i] = p.sh_rest[i] * step;
+
+		if (parent_scale_space)
+			for (int i = 0; i < 3; i++)
+				parent_scale_space[3 * (size_t)g + i] = fromHalfBits(p.scale[i][1]);
+		if (parent_rot_space)
+			for (int i = 0; i < 4; i++)
+				parent_rot_space[4 * (size_t)g + i] = fromHalfBits(p.rotation[1][i]);
+		if (parent_alpha_space)
+			parent_alpha_space[g] = fromHalfBits(p.opacity[1]);
+	}
+}
+
+void MaintenanceCPU::updateStarts(
+	int* nodes,
+	int num_indices,
+	int* indices,
+	int* starts,
+	void* streamy
+)
+{
+	Node* dst_nodes = (Node*)nodes;
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < num_indices; idx++)
+		dst_nodes[indices[idx]].start_children = starts[idx];
+}
@@ -21,6 +21,7 @@
 #include <thrust/device_vector.h>
 #include <cuda.h>
 #include <fstream>
+#include <stdexcept>
 #include <cooperative_groups.h>
 #include <cooperative_groups/reduce.h>
 #include <nvtx3/nvToolsExt.h>
@@ -79,30 +80,108 @@ __global__ void putRenderIndices(Node* nodes, int N, int* node_counts, int* node
 	}
 }
 
-int Switching::expandToTarget(
+void* CUDAWorkspaceBackend::allocate(size_t bytes)
+{
+	void* ptr = nullptr;
+	if (cudaMalloc(&ptr, bytes) != cudaSuccess)
+		return nullptr;
+	return ptr;
+}
+
+void CUDAWorkspaceBackend::release(void* ptr)
+{
+	cudaFree(ptr);
+}
+
+void* CUDAWorkspaceBackend::allocateHost(size_t bytes)
+{
+	void* ptr = nullptr;
+	if (cudaMallocHost(&ptr, bytes) != cudaSuccess)
+		return nullptr;
+	return ptr;
+}
+
+void CUDAWorkspaceBackend::releaseHost(void* ptr)
+{
+	cudaFreeHost(ptr);
+}
+
+size_t CUDAWorkspaceBackend::scratchBytes(int maxN)
+{
+	size_t scan_bytes = 0, select_bytes = 0;
+	cub::DeviceScan::InclusiveSum(nullptr, scan_bytes, (int*)nullptr, (int*)nullptr, maxN);
+	cub::DeviceSelect::Flagged(nullptr, select_bytes, (int*)nullptr, (char*)nullptr, (int*)nullptr, (int*)nullptr, maxN);
+	return std::max(scan_bytes, select_bytes);
+}
+
+// The workspace overloads run on caller reserved buffers. Scans go over n
+// elements, the switching step also selects over up to the capacity.
+static void checkWorkspace(const SwitchingWorkspace& workspace, int n, bool selects)
+{
+	if (!workspace.isDevice())
+		throw std::runtime_error("CUDA traversal needs a device workspace!");
+	if (workspace.capacity() < n)
+		throw std::runtime_error("Switching workspace is too small, reserve it for all nodes first!");
+
+	size_t scan_bytes = 0, select_bytes = 0;
+	cub::DeviceScan::InclusiveSum(nullptr, scan_bytes, (int*)nullptr, (int*)nullptr, selects ? workspace.capacity() : n);
+	if (selects)
+		cub::DeviceSelect::Flagged(nullptr, select_bytes, (int*)nullptr, (char*)nullptr, (int*)nullptr, (int*)nullptr, workspace.capacity());
+	if (workspace.scratchSize() < std::max(scan_bytes, select_bytes))
+		throw std::runtime_error("Switching workspace has too little scratch space!");
+}
+
+// Workspace for the synchronous entry points, one per calling thread
+static SwitchingWorkspace& defaultWorkspace(int N)
+{
+	thread_local SwitchingWorkspace workspace(std::make_shared<CUDAWorkspaceBackend>());
+	workspace.reserve(N);
+	return workspace;
+}
+
+void Switching::expandToTarget(
 	int N,
 	int target,
 	int* nodes,
-	int* render_indices
+	int* render_indices,
+	SwitchingWorkspace& workspace,
+	void* stream
 )
 {
-	thrust::device_vector<int> render_counts(N);
-	thrust::device_vector<int> render_offsets(N);
+	cudaStream_t s = (cudaStream_t)stream;
+	if (N <= 0)
+	{
+		if (workspace.result())
+			workspace.result()[0] = 0;
+		return;
+	}
+	checkWorkspace(workspace, N, false);
+
+	int* render_counts = workspace.counts();
+	int* render_offsets = workspace.offsets();
+	size_t temp_storage_bytes = workspace.scratchSize();
 
 	int num_blocks = (N + 255) / 256;
-	markTargetNodes << <num_blocks, 256 >> > ((Node*)nodes, N, target, render_counts.data().get());
+	markTargetNodes << <num_blocks, 256, 0, s >> > ((Node*)nodes, N, target, render_counts);
 
-	size_t temp_storage_bytes;
-	thrust::device_vector<char> temp_storage;
-	cub::DeviceScan::InclusiveSum(nullptr, temp_storage_bytes, render_counts.data().get(), render_offsets.data().get(), N);
-	temp_storage.resize(temp_storage_bytes);
-	cub::DeviceScan::InclusiveSum(temp_storage.data().get(), temp_storage_bytes, render_counts.data().get(), render_offsets.data().get(), N);
+	cub::DeviceScan::InclusiveSum(workspace.scratch(), temp_storage_bytes, render_counts, render_offsets, N, s);
 
-	putRenderIndices << <num_blocks, 256 >> > ((Node*)nodes, N, render_counts.data().get(), render_offsets.data().get(), render_indices);
+	putRenderIndices << <num_blocks, 256, 0, s >> > ((Node*)nodes, N, render_counts, render_offsets, render_indices);
 
-	int count = 0;
-	cudaMemcpy(&count, render_offsets.data().get() + N - 1, sizeof(int), cudaMemcpyDeviceToHost);
-	return count;
+	cudaMemcpyAsync(workspace.result(), render_offsets + N - 1, sizeof(int), cudaMemcpyDeviceToHost, s);
+}
+
+int Switching::expandToTarget(
+	int N,
+	int target,
+	int* nodes,
+	int* render_indices
+)
+{
+	SwitchingWorkspace& workspace = defaultWorkspace(N);
+	expandToTarget(N, target, nodes, render_indices, workspace, nullptr);
+	cudaStreamSynchronize(nullptr);
+	return workspace.result()[0];
 }
 
 __device__ bool inboxCUDA(Box& box, Point viewpoint)
@@ -115,6 +194,7 @@ __device__ bool inboxCUDA(Box& box, Point viewpoint)
 	return inside;
 }
 
+// Projected size for the interpolation weights, cut decisions use the squared test below
 __device__ float computeSizeGPU(Box& box, Point point, Point viewpoint)
 {
 	if (inboxCUDA(box, viewpoint))
@@ -129,11 +209,66 @@ __device__ float computeSizeGPU(Box& box, Point point, Point viewpoint)
 	return box.maxx.xyz[3] / min_dist;
 }
 
+__device__ float squaredTargetGPU(float target_size)
+{
+	return target_size > 0 ? target_size * target_size : 0.0f;
+}
+
+// Same test as Traversal::reachesSize: computeSizeGPU(box, point, viewpoint) >= target_size
+// without sqrt or division, dist2 is the squared distance to point and t2 the squared target
+__device__ bool reachesSizeGPU(Box& box, float dist2, float t2, Point viewpoint)
+{
+	return dist2 * t2 <= box.maxx.xyz[3] * box.maxx.xyz[3] || inboxCUDA(box, viewpoint);
+}
+
+// Whether the node, or failing that its parent, reaches the target size. With
+// switch distances the center and squared extents come from the SoA and the
+// boxes are only read when the viewpoint may be inside them (distances.x is
+// null for the box based test).
+__device__ void reachesForNode(
+	Node& node,
+	int node_id,
+	Box* boxes,
+	const SwitchDistancesGPU& distances,
+	Point viewpoint,
+	float t2,
+	bool& reached,
+	bool& parent_reached)
+{
+	parent_reached = false;
+	if (distances.x != nullptr)
+	{
+		float dx = viewpoint.xyz[0] - distances.x[node_id];
+		float dy = viewpoint.xyz[1] - distances.y[node_id];
+		float dz = viewpoint.xyz[2] - distances.z[node_id];
+		float dist2 = dx * dx + dy * dy + dz * dz;
+		float scaled = dist2 * t2;
+
+		reached = scaled <= distances.radius2[node_id] || (dist2 <= distances.bound2[node_id] && inboxCUDA(boxes[node_id], viewpoint));
+		if (!reached && distances.parent_radius2[node_id] >= 0)
+			parent_reached = scaled <= distances.parent_radius2[node_id] ||
+				(dist2 <= distances.parent_bound2[node_id] && inboxCUDA(boxes[node.parent], viewpoint));
+		return;
+	}
+
+	Box box = boxes[node_id];
+	Point point = {(box.minn.xyz[0] + box.maxx.xyz[0]) / 2, (box.minn.xyz[1] + box.maxx.xyz[1]) / 2, (box.minn.xyz[2] + box.maxx.xyz[2]) / 2};
+	float dx = viewpoint.xyz[0] - point.xyz[0];
+	float dy = viewpoint.xyz[1] - point.xyz[1];
+	float dz = viewpoint.xyz[2] - point.xyz[2];
+	float dist2 = dx * dx + dy * dy + dz * dz;
+
+	reached = reachesSizeGPU(box, dist2, t2, viewpoint);
+	if (!reached && node.parent != -1)
+		parent_reached = reachesSizeGPU(boxes[node.parent], dist2, t2, viewpoint);
+}
+
 __global__ void changeNodesOnce(
 	Node* nodes,
 	int N,
 	int* indices,
 	Box* boxes,
+	SwitchDistancesGPU distances,
 	Point* viewpoint,
 	Point zdir,
 	float target_size,
@@ -149,13 +284,12 @@ __global__ void changeNodesOnce(
 
 	int node_id = indices[idx];
 	Node node = nodes[node_id];
-	Box box = boxes[node_id];
-	Point point = {(box.minn.xyz[0] + box.maxx.xyz[0]) / 2, (box.minn.xyz[1] + box.maxx.xyz[1]) / 2, (box.minn.xyz[2] + box.maxx.xyz[2]) / 2};
-	float size = computeSizeGPU(box, point, *viewpoint);
+	bool reached, parent_reached;
+	reachesForNode(node, node_id, boxes, distances, *viewpoint, squaredTargetGPU(target_size), reached, parent_reached);
 
 	int count = 1; // repeat yourself
 	char need_child = 0;
-	if (size >= target_size)
+	if (reached)
 	{
 		if (node.depth > 0 && split[node_id] == 0) // split
 		{
@@ -176,9 +310,7 @@ __global__ void changeNodesOnce(
 		int parent_node_id = node.parent;
 		if (parent_node_id != -1)
 		{
-			Node parent_node = nodes[parent_node_id];
-			float parent_size = computeSizeGPU(boxes[parent_node_id], point, *viewpoint);
-			if (parent_size < target_size) // collapse
+			if (!parent_reached) // collapse
 			{
 				split[parent_node_id] = 0;
 				count = 0; // forget yourself
@@ -269,13 +401,14 @@ __global__ void putRenderIndicesIndexed(Node* nodes, int N, int* node_indices, i
 	}
 }
 
-void Switching::changeToSizeStep(
+static void changeToSizeStepBuffers(
 	float target_size,
 	int N,
 	int* node_indices,
 	int* new_node_indices,
 	int* nodes,
 	float* boxes,
+	const SwitchDistancesGPU& distances,
 	float* viewpoint,
 	float x, float y, float z,
 	int* split,
@@ -284,8 +417,8 @@ void Switching::changeToSizeStep(
 	int* nodes_of_render_indices,
 	int* nodes_to_expand,
 	float* debug,
-	char*& scratchspace,
-	size_t& scratchspacesize,
+	char* scratchspace,
+	size_t scratchspacesize,
 	int* NsrcI,
 	int* NdstI,
 	char* NdstC,
@@ -306,26 +439,12 @@ void Switching::changeToSizeStep(
 	int* num_to_expand = numI;
 	int* node_counts = NsrcI, * node_offsets = NdstI, * node_ids = NdstI;
 	char* need_children = NdstC;
-	if (scratchspacesize == 0)
-	{
-		size_t testsize;
-
-		cub::DeviceScan::InclusiveSum(nullptr, testsize, node_counts, node_offsets, maxN, stream);
-		scratchspacesize = testsize;
-		cub::DeviceSelect::Flagged(nullptr, testsize, node_ids, need_children, nodes_to_expand, num_to_expand, maxN, stream);
-		scratchspacesize = std::max(testsize, scratchspacesize);
-
-		if (scratchspace)
-			cudaFree(scratchspace);
-		scratchspacesize = testsize;
-		cudaMalloc(&scratchspace, scratchspacesize);
-	}
-
 	changeNodesOnce << <num_node_blocks, 256, 0, stream >> > (
 		(Node*)nodes, 
 		N, 
 		node_indices, 
 		(Box*)boxes, 
+		distances,
 		(Point*)viewpoint, 
 		zdir, 
 		target_size, 
@@ -388,7 +507,109 @@ void Switching::changeToSizeStep(
 	add_success = 1;
 }
 
-__global__ void markNodesForSize(Node* nodes, Box* boxes, int N, Point* viewpoint, Point zdir, float target_size, int* render_counts, int* node_markers)
+void Switching::changeToSizeStep(
+	float target_size,
+	int N,
+	int* node_indices,
+	int* new_node_indices,
+	int* nodes,
+	float* boxes,
+	float* viewpoint,
+	float x, float y, float z,
+	int* split,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices,
+	int* nodes_to_expand,
+	float* debug,
+	char*& scratchspace,
+	size_t& scratchspacesize,
+	int* NsrcI,
+	int* NdstI,
+	char* NdstC,
+	int* numI,
+	int maxN,
+	int& add_success,
+	int* new_N,
+	int* new_R,
+	int* need_expansion,
+	void* maintenanceStream)
+{
+	if (scratchspacesize == 0)
+	{
+		// Large enough for both the selection and the scans over maxN elements
+		CUDAWorkspaceBackend backend;
+		scratchspacesize = backend.scratchBytes(maxN);
+
+		if (scratchspace)
+			cudaFree(scratchspace);
+		cudaMalloc(&scratchspace, scratchspacesize);
+	}
+
+	changeToSizeStepBuffers(target_size, N, node_indices, new_node_indices, nodes, boxes, SwitchDistancesGPU(), viewpoint, x, y, z,
+		split, render_indices, parent_indices, nodes_of_render_indices, nodes_to_expand, debug,
+		scratchspace, scratchspacesize, NsrcI, NdstI, NdstC, numI, maxN,
+		add_success, new_N, new_R, need_expansion, maintenanceStream);
+}
+
+void Switching::changeToSizeStep(
+	float target_size,
+	int N,
+	int* node_indices,
+	int* new_node_indices,
+	int* nodes,
+	float* boxes,
+	float* viewpoint,
+	float x, float y, float z,
+	int* split,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices,
+	int* nodes_to_expand,
+	float* debug,
+	SwitchingWorkspace& workspace,
+	int& add_success,
+	int* new_N,
+	int* new_R,
+	int* need_expansion,
+	void* maintenanceStream)
+{
+	changeToSizeStep(target_size, N, node_indices, new_node_indices, nodes, boxes, SwitchDistancesGPU(), viewpoint, x, y, z,
+		split, render_indices, parent_indices, nodes_of_render_indices, nodes_to_expand, debug,
+		workspace, add_success, new_N, new_R, need_expansion, maintenanceStream);
+}
+
+void Switching::changeToSizeStep(
+	float target_size,
+	int N,
+	int* node_indices,
+	int* new_node_indices,
+	int* nodes,
+	float* boxes,
+	const SwitchDistancesGPU& distances,
+	float* viewpoint,
+	float x, float y, float z,
+	int* split,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_of_render_indices,
+	int* nodes_to_expand,
+	float* debug,
+	SwitchingWorkspace& workspace,
+	int& add_success,
+	int* new_N,
+	int* new_R,
+	int* need_expansion,
+	void* maintenanceStream)
+{
+	checkWorkspace(workspace, N, true);
+	changeToSizeStepBuffers(target_size, N, node_indices, new_node_indices, nodes, boxes, distances, viewpoint, x, y, z,
+		split, render_indices, parent_indices, nodes_of_render_indices, nodes_to_expand, debug,
+		workspace.scratch(), workspace.scratchSize(), workspace.counts(), workspace.offsets(), workspace.flags(), workspace.deviceResult(), workspace.capacity(),
+		add_success, new_N, new_R, need_expansion, maintenanceStream);
+}
+
+__global__ void markNodesForSize(Node* nodes, Box* boxes, SwitchDistancesGPU distances, int N, Point* viewpoint, Point zdir, float target_size, int* render_counts, int* node_markers)
 {
 	int idx = blockDim.x * blockIdx.x + threadIdx.x;
 	if (idx >= N)
@@ -396,22 +617,17 @@ __global__ void markNodesForSize(Node* nodes, Box* boxes, int N, Point* viewpoin
 
 	int node_id = idx;
 	Node node = nodes[node_id];
-	Box box = boxes[node_id];
-	Point point = {(box.minn.xyz[0] + box.maxx.xyz[0]) / 2, (box.minn.xyz[1] + box.maxx.xyz[1]) / 2, (box.minn.xyz[2] + box.maxx.xyz[2]) / 2};
-	float size = computeSizeGPU(box, point, *viewpoint);
+	bool reached, parent_reached;
+	reachesForNode(node, node_id, boxes, distances, *viewpoint, squaredTargetGPU(target_size), reached, parent_reached);
 
 	int count = 0;
-	if (size >= target_size)
+	if (reached)
 		count = node.count_leafs;
-	else if (node.parent != -1)
+	else if (parent_reached)
 	{
-		float parent_size = computeSizeGPU(boxes[node.parent], point, *viewpoint);
-		if (parent_size >= target_size)
-		{
-			count = node.count_leafs;
-			if (node.depth != 0)
-				count += node.count_merged;
-		}
+		count = node.count_leafs;
+		if (node.depth != 0)
+			count += node.count_merged;
 	}
 
 	if (count != 0 && node_markers != nullptr)
@@ -500,7 +716,7 @@ void Switching::getTsIndexed(
 		kids);
 }
 
-int Switching::expandToSize(
+void Switching::expandToSize(
 	int N,
 	float target_size,
 	int* nodes,
@@ -510,27 +726,70 @@ int Switching::expandToSize(
 	int* render_indices,
 	int* node_markers,
 	int* parent_indices,
-	int* nodes_for_render_indices)
+	int* nodes_for_render_indices,
+	SwitchingWorkspace& workspace,
+	void* stream)
 {
-	size_t temp_storage_bytes;
-	thrust::device_vector<char> temp_storage;
-	thrust::device_vector<int> render_counts(N);
-	thrust::device_vector<int> render_offsets(N);
+	expandToSize(N, target_size, nodes, boxes, SwitchDistancesGPU(), viewpoint, x, y, z,
+		render_indices, node_markers, parent_indices, nodes_for_render_indices, workspace, stream);
+}
+
+void Switching::expandToSize(
+	int N,
+	float target_size,
+	int* nodes,
+	float* boxes,
+	const SwitchDistancesGPU& distances,
+	float* viewpoint,
+	float x, float y, float z,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	SwitchingWorkspace& workspace,
+	void* stream)
+{
+	cudaStream_t s = (cudaStream_t)stream;
+	if (N <= 0)
+	{
+		if (workspace.result())
+			workspace.result()[0] = 0;
+		return;
+	}
+	checkWorkspace(workspace, N, false);
+
+	int* render_counts = workspace.counts();
+	int* render_offsets = workspace.offsets();
+	size_t temp_storage_bytes = workspace.scratchSize();
 
 	Point zdir = { x, y, z };
 
 	int num_blocks = (N + 255) / 256;
-	markNodesForSize << <num_blocks, 256 >> > ((Node*)nodes, (Box*)boxes, N, (Point*)viewpoint, zdir, target_size, render_counts.data().get(), node_markers);
+	markNodesForSize << <num_blocks, 256, 0, s >> > ((Node*)nodes, (Box*)boxes, distances, N, (Point*)viewpoint, zdir, target_size, render_counts, node_markers);
 
-	cub::DeviceScan::InclusiveSum(nullptr, temp_storage_bytes, render_counts.data().get(), render_offsets.data().get(), N);
-	temp_storage.resize(temp_storage_bytes);
-	cub::DeviceScan::InclusiveSum(temp_storage.data().get(), temp_storage_bytes, render_counts.data().get(), render_offsets.data().get(), N);
+	cub::DeviceScan::InclusiveSum(workspace.scratch(), temp_storage_bytes, render_counts, render_offsets, N, s);
 
-	putRenderIndices << <num_blocks, 256 >> > ((Node*)nodes, N, render_counts.data().get(), render_offsets.data().get(), render_indices, parent_indices, nodes_for_render_indices);
+	putRenderIndices << <num_blocks, 256, 0, s >> > ((Node*)nodes, N, render_counts, render_offsets, render_indices, parent_indices, nodes_for_render_indices);
 
-	int count = 0;
-	cudaMemcpy(&count, render_offsets.data().get() + N - 1, sizeof(int), cudaMemcpyDeviceToHost);
-	return count;
+	cudaMemcpyAsync(workspace.result(), render_offsets + N - 1, sizeof(int), cudaMemcpyDeviceToHost, s);
+}
+
+int Switching::expandToSize(
+	int N,
+	float target_size,
+	int* nodes,
+	float* boxes,
+	float* viewpoint,
+	float x, float y, float z,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices)
+{
+	SwitchingWorkspace& workspace = defaultWorkspace(N);
+	expandToSize(N, target_size, nodes, boxes, viewpoint, x, y, z, render_indices, node_markers, parent_indices, nodes_for_render_indices, workspace, nullptr);
+	cudaStreamSynchronize(nullptr);
+	return workspace.result()[0];
 }
 
 void Switching::markVisibleForAllViewpoints(
@@ -566,6 +825,7 @@ void Switching::markVisibleForAllViewpoints(
 		markNodesForSize << <num_blocks, 256 >> > (
 			nodes_cuda.data().get(),
 			boxes_cuda.data().get(),
+			SwitchDistancesGPU(),
 			num_nodes,
 			viewpoint_cuda.data().get(),
 			zdir,
@@ -13,6 +13,33 @@
 #include <cstdio>
 #include <tuple>
 #include <string>
+#include "switching_workspace.h"
+
+// Device memory through cudaMalloc, scratch sized for the cub scans and selections
+class CUDAWorkspaceBackend : public WorkspaceBackend
+{
+public:
+	void* allocate(size_t bytes) override;
+	void release(void* ptr) override;
+	void* allocateHost(size_t bytes) override;
+	void releaseHost(void* ptr) override;
+	size_t scratchBytes(int maxN) override;
+	bool isDevice() const override { return true; }
+};
+
+// Device copies of the arrays of SwitchDistances (traversal.h), N floats each,
+// for the size tests of the expand and switching functions. Without them
+// (x == nullptr) the tests read the boxes.
+struct SwitchDistancesGPU
+{
+	const float* x = nullptr;
+	const float* y = nullptr;
+	const float* z = nullptr;
+	const float* radius2 = nullptr;
+	const float* bound2 = nullptr;
+	const float* parent_radius2 = nullptr;
+	const float* parent_bound2 = nullptr;
+};
 
 class Switching
 {
@@ -37,6 +64,49 @@ public:
 		int* parent_indices = nullptr,
 		int* nodes_for_render_indices=nullptr);
 
+	// Same as above, with all temporary buffers taken from a device workspace
+	// reserved for at least N nodes, throws otherwise. Nothing is synchronized: the
+	// number of render indices arrives in workspace.result()[0] once the stream completes.
+	static void expandToTarget(
+		int N,
+		int target,
+		int* nodes,
+		int* render_indices,
+		SwitchingWorkspace& workspace,
+		void* stream
+	);
+
+	static void expandToSize(
+		int N,
+		float target_size,
+		int* nodes,
+		float* boxes,
+		float* viewpoint,
+		float x, float y, float z,
+		int* render_indices,
+		int* node_markers,
+		int* parent_indices,
+		int* nodes_for_render_indices,
+		SwitchingWorkspace& workspace,
+		void* stream);
+
+	// Same as above with the size tests on precomputed switch distances, the
+	// boxes are only read for nodes the viewpoint may be inside of
+	static void expandToSize(
+		int N,
+		float target_size,
+		int* nodes,
+		float* boxes,
+		const SwitchDistancesGPU& distances,
+		float* viewpoint,
+		float x, float y, float z,
+		int* render_indices,
+		int* node_markers,
+		int* parent_indices,
+		int* nodes_for_render_indices,
+		SwitchingWorkspace& workspace,
+		void* stream);
+
 	static void getTsIndexed(
 		int N,
 		int* indices,
@@ -78,6 +148,58 @@ public:
 		int* need_expansion,
 		void* maintenanceStream);
 
+	// Same as above, with the scratch space and the maxN sized node buffers
+	// (NsrcI, NdstI, NdstC, numI) taken from the workspace. Throws if it is not
+	// a device workspace reserved for at least N nodes. maxN is the workspace
+	// capacity(), so new_node_indices and the render buffers (render_indices,
+	// parent_indices, nodes_of_render_indices) must hold capacity() entries too.
+	static void changeToSizeStep(
+		float target_size,
+		int N,
+		int* node_indices,
+		int* new_node_indices,
+		int* nodes,
+		float* boxes,
+		float* viewpoint,
+		float x, float y, float z,
+		int* split,
+		int* render_indices,
+		int* parent_indices,
+		int* nodes_of_render_indices,
+		int* nodes_to_expand,
+		float* debug,
+		SwitchingWorkspace& workspace,
+		int& add_success,
+		int* new_N,
+		int* new_R,
+		int* need_expansion,
+		void* maintenanceStream);
+
+	// Same as above with the size tests on precomputed switch distances, and
+	// the same capacity() bound on the caller's buffers
+	static void changeToSizeStep(
+		float target_size,
+		int N,
+		int* node_indices,
+		int* new_node_indices,
+		int* nodes,
+		float* boxes,
+		const SwitchDistancesGPU& distances,
+		float* viewpoint,
+		float x, float y, float z,
+		int* split,
+		int* render_indices,
+		int* parent_indices,
+		int* nodes_of_render_indices,
+		int* nodes_to_expand,
+		float* debug,
+		SwitchingWorkspace& workspace,
+		int& add_success,
+		int* new_N,
+		int* new_R,
+		int* need_expansion,
+		void* maintenanceStream);
+
 	static void markVisibleForAllViewpoints(
 		float target_size,
 		int* nodes,
@@ -23,10 +23,13 @@ setup(
             "hierarchy_loader.cpp",
             "hierarchy_writer.cpp",
             "traversal.cpp",
+            "switching_workspace.cpp",
             "runtime_switching.cu",
             "torch/torch_interface.cpp",
             "ext.cpp"],
-            extra_compile_args={"cxx": ["-I" + os.path.join(os.path.dirname(os.path.abspath(__file__)), "dependencies/eigen/")]}
+            extra_compile_args={"cxx": ["-I" + os.path.join(os.path.dirname(os.path.abspath(__file__)), "dependencies/eigen/"),
+                                        "/openmp" if os.name == "nt" else "-fopenmp"]},
+            extra_link_args=[] if os.name == "nt" else ["-fopenmp"]
             )
         ],
     cmdclass={
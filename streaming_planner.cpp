@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "streaming_planner.h"
+#include "residency_manager.h"
+#include "traversal.h"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+
+StreamingPlanner::StreamingPlanner(std::shared_ptr<const HierarchyView> view) :
+	view(std::move(view))
+{
+	if (this->view->numNodes() == 0)
+		throw std::runtime_error("Streaming planner needs a non-empty hierarchy");
+
+	const Node& root = this->view->nodes()[0];
+	base_bytes = ResidencyManager::bytesPerNode() + (root.count_leafs + root.count_merged) * ResidencyManager::bytesPerGaussian();
+}
+
+size_t StreamingPlanner::groupBytes(int node_id) const
+{
+	const Node* nodes = view->nodes();
+	const Node& node = nodes[node_id];
+
+	size_t bytes = 0;
+	for (int i = 0; i < node.count_children; i++)
+	{
+		const Node& child = nodes[node.start_children + i];
+		bytes += ResidencyManager::bytesPerNode() + (child.count_leafs + child.count_merged) * ResidencyManager::bytesPerGaussian();
+	}
+	return bytes;
+}
+
+void StreamingPlanner::simulate(const std::vector<Point>& path, float target_size, int linger_frames)
+{
+	const Node* nodes = view->nodes();
+	const Box* boxes = view->boxes();
+	int N = view->numNodes();
+	float t2 = Traversal::squaredTarget(target_size);
+
+	requests.clear();
+	num_frames = (int)path.size();
+
+	// Interval currently open for each node, -1 if none
+	std::vector<int> open_first(N, -1), open_last(N, -1);
+	std::vector<int> opened;
+	std::vector<int> stack;
+
+	auto close = [&](int node_id) {
+		requests.push_back({ node_id, groupBytes(node_id), open_first[node_id], open_last[node_id] });
+		open_first[node_id] = -1;
+	};
+
+	for (int f = 0; f < num_frames; f++)
+	{
+		const Point& viewpoint = path[f];
+
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			int node_id = stack.back();
+			stack.pop_back();
+
+			const Node& node = nodes[node_id];
+			const Box& box = boxes[node_id];
+			if (node.depth == 0 || node.count_children == 0 || node.start_children == -1)
+				continue;
+
+			Point diff = viewpoint - (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+			float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+			if (!Traversal::reachesSize(box, dist2, t2, viewpoint))
+				continue;
+
+			if (open_first[node_id] != -1 && f - open_last[node_id] - 1 > linger_frames)
+				close(node_id);
+			if (open_first[node_id] == -1)
+			{
+				open_first[node_id] = f;
+				opened.push_back(node_id);
+			}
+			open_last[node_id] = f;
+
+			for (int i = 0; i < node.count_children; i++)
+				stack.push_back(node.start_children + i);
+		}
+	}
+
+	for (int node_id : opened)
+		if (open_first[node_id] != -1)
+			close(node_id);
+
+	// Parents have lower ids, so they come first among loads needed on the same frame
+	std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+		if (a.first_frame != b.first_frame)
+			return a.first_frame < b.first_frame;
+		return a.node_id < b.node_id;
+	});
+
+	// Merged intervals keep groups through the gaps, so the peak comes from the intervals
+	std::vector<long long> change(num_frames + 1, 0);
+	for (const Request& r : requests)
+	{
+		change[r.first_frame] += r.bytes;
+		change[r.last_frame + 1] -= r.bytes;
+	}
+	long long bytes = base_bytes;
+	peak_bytes = base_bytes;
+	for (int f = 0; f < num_frames; f++)
+	{
+		bytes += change[f];
+		peak_bytes = std::max(peak_bytes, (size_t)bytes);
+	}
+}
+
+size_t StreamingPlanner::totalBytes() const
+{
+	size_t bytes = 0;
+	for (const Request& r : requests)
+		bytes += r.bytes;
+	return bytes;
+}
+
+double StreamingPlanner::preloadFrames(double bandwidth) const
+{
+	size_t bytes = 0;
+	for (const Request& r : requests)
+		if (r.first_frame == 0)
+			bytes += r.bytes;
+	return bytes / bandwidth;
+}
+
+int StreamingPlanner::schedule(
+	float speed,
+	double bandwidth,
+	size_t memory_budget,
+	std::vector<PrefetchEntry>* entries,
+	double* stall_frames) const
+{
+	if (speed <= 0 || bandwidth <= 0)
+		throw std::runtime_error("Streaming schedule needs a positive speed and bandwidth");
+
+	// Times are in displayed frames, playback starts once the preload is done
+	double start = preloadFrames(bandwidth);
+	auto frameTime = [&](int frame) { return start + frame / (double)speed; };
+	auto toTrajectory = [&](double time) { return (time - start) * speed; };
+
+	typedef std::pair<double, size_t> Resident; // end time, bytes
+	std::priority_queue<Resident, std::vector<Resident>, std::greater<Resident>> resident;
+	size_t resident_bytes = base_bytes;
+
+	if (entries)
+		entries->clear();
+
+	double channel = 0;
+	double stall = 0;
+	int late = 0;
+	for (const Request& r : requests)
+	{
+		double issue = channel;
+		while (!resident.empty() && resident.top().first <= issue)
+		{
+			resident_bytes -= resident.top().second;
+			resident.pop();
+		}
+		while (resident_bytes + r.bytes > memory_budget && !resident.empty())
+		{
+			issue = std::max(issue, resident.top().first);
+			resident_bytes -= resident.top().second;
+			resident.pop();
+		}
+		if (resident_bytes + r.bytes > memory_budget)
+		{
+			late++; // Does not fit even with nothing else loaded
+			continue;
+		}
+
+		double complete = issue + r.bytes / bandwidth;
+		channel = complete;
+
+		double deadline = frameTime(r.first_frame);
+		if (complete > deadline + 1e-9)
+		{
+			late++;
+			stall += complete - deadline;
+		}
+
+		resident.push(Resident(frameTime(r.last_frame + 1), r.bytes));
+		resident_bytes += r.bytes;
+
+		if (entries)
+			entries->push_back({ r.node_id, r.bytes, r.first_frame, r.last_frame, toTrajectory(issue), toTrajectory(complete) });
+	}
+
+	if (stall_frames)
+		*stall_frames = stall;
+	return late;
+}
+
+float StreamingPlanner::maxStallFreeSpeed(double bandwidth, size_t memory_budget) const
+{
+	float lo = 1.0f / 256, hi = 256.0f;
+	if (schedule(lo, bandwidth, memory_budget) != 0)
+		return 0;
+	if (schedule(hi, bandwidth, memory_budget) == 0)
+		return hi;
+
+	for (int i = 0; i < 30; i++)
+	{
+		float mid = std::sqrt(lo * hi);
+		if (schedule(mid, bandwidth, memory_budget) == 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+bool StreamingPlanner::writeSchedule(const char* filename, const std::vector<PrefetchEntry>& entries)
+{
+	std::ofstream outfile(filename);
+	if (!outfile.good())
+		return false;
+
+	outfile << "# issue_frame complete_frame node_id bytes first_frame last_frame" << std::endl;
+	for (const PrefetchEntry& e : entries)
+		outfile << e.issue << " " << e.complete << " " << e.node_id << " " << e.bytes << " " << e.first_frame << " " << e.last_frame << std::endl;
+	return true;
+}
+
+static Point colmapCenter(double qw, double qx, double qy, double qz, double tx, double ty, double tz)
+{
+	const Eigen::Quaternionf quat((float)qw, (float)qx, (float)qy, (float)qz);
+	const Eigen::Matrix3f orientation = quat.toRotationMatrix().transpose();
+	return -(orientation * Eigen::Vector3f((float)tx, (float)ty, (float)tz));
+}
+
+std::vector<Point> StreamingPlanner::loadTrajectory(const std::string& path)
+{
+	std::vector<std::pair<std::string, Point>> images;
+
+	std::ifstream binfile(path + "/sparse/0/images.bin", std::ios::binary);
+	std::ifstream txtfile(path + "/sparse/0/images.txt");
+	if (binfile.good())
+	{
+		const size_t num_reg_images = ReadBinaryLittleEndian<uint64_t>(&binfile);
+		for (size_t i = 0; i < num_reg_images; i++)
+		{
+			ReadBinaryLittleEndian<uint32_t>(&binfile); // image id
+			double q[4], t[3];
+			for (int j = 0; j < 4; j++)
+				q[j] = ReadBinaryLittleEndian<double>(&binfile);
+			for (int j = 0; j < 3; j++)
+				t[j] = ReadBinaryLittleEndian<double>(&binfile);
+			ReadBinaryLittleEndian<uint32_t>(&binfile); // camera id
+
+			std::string name;
+			char name_char;
+			while (binfile.read(&name_char, 1) && name_char != '\0')
+				name.push_back(name_char);
+
+			// Skip the 2D points, x and y as double and a 64 bit point id each
+			const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(&binfile);
+			binfile.seekg(num_points2D * 24, std::ios::cur);
+
+			images.push_back(std::make_pair(name, colmapCenter(q[0], q[1], q[2], q[3], t[0], t[1], t[2])));
+		}
+	}
+	else if (txtfile.good())
+	{
+		// Two lines per image, the second one lists the 2D points and may be
+		// empty. Only lines where an image is expected can be comments.
+		std::string line, points_line;
+		while (std::getline(txtfile, line))
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream iss(line);
+			int id, camera_id;
+			double qw, qx, qy, qz, tx, ty, tz;
+			std::string name;
+			if (iss >> id >> qw >> qx >> qy >> qz >> tx >> ty >> tz >> camera_id >> name)
+				images.push_back(std::make_pair(name, colmapCenter(qw, qx, qy, qz, tx, ty, tz)));
+			std::getline(txtfile, points_line);
+		}
+	}
+	else
+	{
+		std::ifstream infile(path);
+		if (!infile.good())
+			throw std::runtime_error("Could not open trajectory");
+
+		std::vector<Point> positions;
+		std::string line;
+		while (std::getline(infile, line))
+		{
+			std::istringstream iss(line);
+			Point p;
+			if (iss >> p[0] >> p[1] >> p[2])
+				positions.push_back(p);
+		}
+		return positions;
+	}
+
+	std::sort(images.begin(), images.end(), [](const std::pair<std::string, Point>& a, const std::pair<std::string, Point>& b) { return a.first < b.first; });
+
+	std::vector<Point> positions;
+	for (auto& image : images)
+		positions.push_back(image.second);
+	return positions;
+}
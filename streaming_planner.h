@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include "common.h"
+#include "hierarchy_view.h"
+
+// One load of the schedule: the children of node_id (the unit nodes_to_expand
+// asks for) must be resident for trajectory frames first_frame to last_frame.
+// issue and complete are in trajectory frames, negative during the preload.
+struct PrefetchEntry
+{
+	int node_id;
+	size_t bytes;
+	int first_frame;
+	int last_frame;
+	double issue;
+	double complete;
+};
+
+// Plans the streaming of a known camera path. simulate() replays the path
+// with the same cut rules as TraversalSession and records, for every node
+// that is split, the frame intervals in which its children are needed.
+// Intervals closer than linger_frames are merged so a group is not dropped
+// and reloaded for a short gap. schedule() then streams the loads in order of
+// their first frame through a single channel of the given bandwidth, never
+// holding more than the memory budget: a load waits until enough earlier
+// loads have passed their last frame. Loads needed on the first frame form
+// the preload before playback starts.
+class StreamingPlanner
+{
+public:
+	StreamingPlanner(std::shared_ptr<const HierarchyView> view);
+
+	void simulate(const std::vector<Point>& path, float target_size, int linger_frames = 10);
+
+	// speed is trajectory frames per displayed frame, bandwidth is in bytes per
+	// displayed frame. Returns the number of loads that complete after their
+	// first frame or never fit the budget; stall_frames sums how late they are.
+	int schedule(
+		float speed,
+		double bandwidth,
+		size_t memory_budget,
+		std::vector<PrefetchEntry>* entries = nullptr,
+		double* stall_frames = nullptr) const;
+
+	// Highest speed for which schedule() reports no late load, 0 if none
+	float maxStallFreeSpeed(double bandwidth, size_t memory_budget) const;
+
+	// Displayed frames spent loading before the first frame can be shown
+	double preloadFrames(double bandwidth) const;
+
+	int numFrames() const { return num_frames; }
+	int numLoads() const { return (int)requests.size(); }
+	size_t totalBytes() const;
+	size_t peakWorkingSet() const { return peak_bytes; }
+
+	// Bytes that are always resident: the root node and its Gaussians
+	size_t baseBytes() const { return base_bytes; }
+
+	static bool writeSchedule(const char* filename, const std::vector<PrefetchEntry>& entries);
+
+	// Camera positions of a COLMAP reconstruction (folder containing
+	// sparse/0/images.bin or images.txt) ordered by image name, or of a text
+	// file with one "x y z" position per line
+	static std::vector<Point> loadTrajectory(const std::string& path);
+
+private:
+	struct Request
+	{
+		int node_id;
+		size_t bytes;
+		int first_frame;
+		int last_frame;
+	};
+
+	size_t groupBytes(int node_id) const;
+
+	std::shared_ptr<const HierarchyView> view;
+	std::vector<Request> requests;
+	int num_frames = 0;
+	size_t base_bytes = 0;
+	size_t peak_bytes = 0;
+};
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "subtree_prefetcher.h"
+#include "traversal.h"
+#include <algorithm>
+
+SubtreePrefetcher::SubtreePrefetcher(std::shared_ptr<const HierarchyView> view, int lookahead_frames, float relax) :
+	view(std::move(view)),
+	lookahead(lookahead_frames),
+	relax(relax),
+	position(Point::Zero()),
+	velocity(Point::Zero()),
+	acceleration(Point::Zero()),
+	predicted(Point::Zero())
+{
+	int N = this->view->numNodes();
+	resident.resize(N, 0);
+	missed.resize(N, 0);
+	prefetched_at.resize(N, -1);
+	last_use.resize(N, -1);
+}
+
+void SubtreePrefetcher::splitNodes(const Point& viewpoint, float target_size, std::vector<int>& split)
+{
+	const Node* nodes = view->nodes();
+	const Box* boxes = view->boxes();
+	float t2 = Traversal::squaredTarget(target_size);
+
+	split.clear();
+	if (view->numNodes() == 0)
+		return;
+
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		int node_id = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[node_id];
+		const Box& box = boxes[node_id];
+		if (node.depth == 0 || node.count_children == 0 || node.start_children == -1)
+			continue;
+
+		Point diff = viewpoint - (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+		if (!Traversal::reachesSize(box, dist2, t2, viewpoint))
+			continue;
+
+		split.push_back(node_id);
+		for (int i = 0; i < node.count_children; i++)
+			stack.push_back(node.start_children + i);
+	}
+	std::sort(split.begin(), split.end());
+}
+
+int SubtreePrefetcher::update(const Point& viewpoint, float target_size, int num_nodes, const int* cuda2cpu, const int* split, std::vector<int>& loads)
+{
+	// Finite differences over frames, the acceleration is smoothed against jitter
+	if (frame == 0)
+	{
+		velocity = Point::Zero();
+		acceleration = Point::Zero();
+	}
+	else
+	{
+		Point v = viewpoint - position;
+		acceleration = 0.5f * acceleration + 0.5f * (v - velocity);
+		velocity = v;
+	}
+	position = viewpoint;
+	float n = (float)lookahead;
+	predicted = position + velocity * n + 0.5f * acceleration * n * n;
+
+	// Groups whose children the working set holds now
+	for (int node_id : resident_nodes)
+		resident[node_id] = 0;
+	resident_nodes.clear();
+	for (int i = 0; i < num_nodes; i++)
+	{
+		if (!split[i])
+			continue;
+		int node_id = cuda2cpu[i];
+		resident[node_id] = 1;
+		missed[node_id] = 0;
+		resident_nodes.push_back(node_id);
+	}
+
+	// Last frame's loads that made it in, the others may be issued again
+	for (int node_id : issued_nodes)
+	{
+		if (!resident[node_id] || prefetched_at[node_id] != -1)
+			continue;
+		prefetched_at[node_id] = frame - 1;
+		prefetched_nodes.push_back(node_id);
+		num_accepted++;
+	}
+	issued_nodes.clear();
+
+	// Prefetches that left the working set or went unused before they were needed
+	int kept = 0;
+	for (int node_id : prefetched_nodes)
+	{
+		if (prefetched_at[node_id] == -1)
+			continue;
+		if (!resident[node_id] || frame - last_use[node_id] > lookahead)
+		{
+			num_wasted++;
+			prefetched_at[node_id] = -1;
+			continue;
+		}
+		prefetched_nodes[kept++] = node_id;
+	}
+	prefetched_nodes.resize(kept);
+
+	// Score the groups the current cut needs
+	splitNodes(viewpoint, target_size, needed);
+	for (int node_id : needed)
+	{
+		if (prefetched_at[node_id] != -1)
+		{
+			num_hits++;
+			prefetched_at[node_id] = -1;
+		}
+		else if (!resident[node_id] && !missed[node_id])
+		{
+			num_misses++;
+			missed[node_id] = 1;
+		}
+		last_use[node_id] = frame;
+	}
+
+	// Queue what the cuts along the predicted path need, one pose per frame
+	// ahead, so that groups only passed on the way are not missed. Missed
+	// groups are left to the reactive expansion.
+	predicted_split.clear();
+	for (int k = 1; k <= lookahead; k++)
+	{
+		float m = (float)k;
+		splitNodes(position + velocity * m + 0.5f * acceleration * m * m, target_size * relax, pose_split);
+		predicted_split.insert(predicted_split.end(), pose_split.begin(), pose_split.end());
+	}
+	std::sort(predicted_split.begin(), predicted_split.end());
+	predicted_split.erase(std::unique(predicted_split.begin(), predicted_split.end()), predicted_split.end());
+
+	int count = 0;
+	for (int node_id : predicted_split)
+	{
+		if (!resident[node_id] && !missed[node_id])
+		{
+			issued_nodes.push_back(node_id);
+			loads.push_back(node_id);
+			num_issued++;
+			count++;
+		}
+		last_use[node_id] = frame;
+	}
+
+	frame++;
+	return count;
+}
+
+float SubtreePrefetcher::hitRate() const
+{
+	size_t needed = num_hits + num_misses;
+	return needed == 0 ? 0.0f : num_hits / (float)needed;
+}
+
+float SubtreePrefetcher::wasteRate() const
+{
+	return num_accepted == 0 ? 0.0f : num_wasted / (float)num_accepted;
+}
+
+void SubtreePrefetcher::resetStats()
+{
+	num_issued = 0;
+	num_accepted = 0;
+	num_hits = 0;
+	num_misses = 0;
+	num_wasted = 0;
+}
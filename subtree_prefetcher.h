@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "common.h"
+#include "hierarchy_view.h"
+
+// Anticipates expansions of an interactive session. Every frame the camera
+// velocity and acceleration are updated from the observed positions and the
+// poses 1 to lookahead_frames frames ahead are extrapolated. The cuts at these
+// poses are evaluated with the target size scaled by relax (< 1 splits
+// earlier), and split nodes whose children are not resident are queued.
+// Node ids are hierarchy ids, the values of cuda2cpu, a load means the node's
+// children; ResidencyManager::prefetch takes the loads as they are.
+//
+// The statistics follow what the working set actually holds, passed in as its
+// cuda2cpu and split arrays, so call update() before the frame's reactive
+// expansion. A load is accepted once its group is resident at the next update,
+// dropped or deferred loads are issued again while they are predicted. A
+// group the current cut needs is a hit when an accepted prefetch brought it
+// in, and a miss when it is not resident (a reactive load through
+// nodes_to_expand). Accepted prefetches that are evicted, or not needed or
+// predicted for lookahead_frames, before the cut needed them count as wasted.
+class SubtreePrefetcher
+{
+public:
+	SubtreePrefetcher(std::shared_ptr<const HierarchyView> view, int lookahead_frames, float relax = 0.75f);
+
+	// Appends the groups to load for this frame to loads, parents first.
+	// num_nodes, cuda2cpu and split describe the current working set, e.g.
+	// those of ResidencyManager. Returns the number appended.
+	int update(const Point& viewpoint, float target_size, int num_nodes, const int* cuda2cpu, const int* split, std::vector<int>& loads);
+
+	// Pose lookahead_frames ahead, the last one evaluated
+	const Point& predictedViewpoint() const { return predicted; }
+
+	size_t issued() const { return num_issued; }
+	size_t accepted() const { return num_accepted; }
+	size_t hits() const { return num_hits; }
+	size_t misses() const { return num_misses; }
+	size_t wasted() const { return num_wasted; }
+
+	// Share of needed groups that were prefetched, and of accepted prefetches never needed
+	float hitRate() const;
+	float wasteRate() const;
+
+	void resetStats();
+
+private:
+	void splitNodes(const Point& viewpoint, float target_size, std::vector<int>& split);
+
+	std::shared_ptr<const HierarchyView> view;
+	int lookahead;
+	float relax;
+
+	int frame = 0;
+	Point position, velocity, acceleration, predicted;
+
+	std::vector<char> resident; // children of the node are in the working set
+	std::vector<char> missed; // needed while not resident, scored once until it is
+	std::vector<int> prefetched_at; // frame of an accepted, unscored prefetch, -1 otherwise
+	std::vector<int> last_use; // last frame the group was needed or predicted
+	std::vector<int> resident_nodes, issued_nodes, prefetched_nodes;
+	std::vector<int> needed, pose_split, predicted_split, stack;
+
+	size_t num_issued = 0;
+	size_t num_accepted = 0;
+	size_t num_hits = 0;
+	size_t num_misses = 0;
+	size_t num_wasted = 0;
+};
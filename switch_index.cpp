@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "switch_index.h"
+#include "traversal.h"
+#include <algorithm>
+
+#define BVH_LEAF_SIZE 4
+
+void SwitchIndex::build(int N, Node* nodes, Box* boxes, float target_size)
+{
+	this->N = N;
+	this->nodes = nodes;
+	this->boxes = boxes;
+	this->target_size = target_size;
+
+	bvh.clear();
+	items.clear();
+	item_minn.clear();
+	item_maxx.clear();
+
+	// Every node reaches a non-positive target, nothing to index
+	if (N <= 0 || target_size <= 0)
+		return;
+
+	std::vector<Eigen::Vector3f> minn(N), maxx(N), centers(N);
+
+#pragma omp parallel for
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Box& box = boxes[idx];
+		Point center = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+
+		float extent = box.maxx[3];
+		Eigen::Vector3f lo = box.minn.head<3>();
+		Eigen::Vector3f hi = box.maxx.head<3>();
+
+		int parent = nodes[idx].parent;
+		if (parent != -1)
+		{
+			const Box& pbox = boxes[parent];
+			extent = std::max(extent, pbox.maxx[3]);
+			lo = lo.cwiseMin(pbox.minn.head<3>());
+			hi = hi.cwiseMax(pbox.maxx.head<3>());
+		}
+
+		// Small margin so that rounding never drops a node on the sphere surface
+		float radius = extent / target_size * 1.0001f + 1e-6f;
+		minn[idx] = lo.cwiseMin((center.array() - radius).matrix());
+		maxx[idx] = hi.cwiseMax((center.array() + radius).matrix());
+		centers[idx] = (minn[idx] + maxx[idx]) / 2;
+	}
+
+	items.resize(N);
+	for (int i = 0; i < N; i++)
+		items[i] = i;
+
+	bvh.reserve(2 * (N / BVH_LEAF_SIZE + 1));
+	bvh.push_back(BVHNode());
+	item_minn.swap(minn);
+	item_maxx.swap(maxx);
+	buildRec(0, 0, N, centers);
+
+	// Store the item bounds in leaf order for a linear walk during queries
+	std::vector<Eigen::Vector3f> ordered_minn(N), ordered_maxx(N);
+	for (int i = 0; i < N; i++)
+	{
+		ordered_minn[i] = item_minn[items[i]];
+		ordered_maxx[i] = item_maxx[items[i]];
+	}
+	item_minn.swap(ordered_minn);
+	item_maxx.swap(ordered_maxx);
+}
+
+void SwitchIndex::buildRec(int current, int begin, int end, const std::vector<Eigen::Vector3f>& centers)
+{
+	Eigen::Vector3f minn = item_minn[items[begin]], maxx = item_maxx[items[begin]];
+	Eigen::Vector3f cminn = centers[items[begin]], cmaxx = cminn;
+	for (int i = begin + 1; i < end; i++)
+	{
+		int item = items[i];
+		minn = minn.cwiseMin(item_minn[item]);
+		maxx = maxx.cwiseMax(item_maxx[item]);
+		cminn = cminn.cwiseMin(centers[item]);
+		cmaxx = cmaxx.cwiseMax(centers[item]);
+	}
+	bvh[current].minn = minn;
+	bvh[current].maxx = maxx;
+
+	if (end - begin <= BVH_LEAF_SIZE)
+	{
+		bvh[current].start = begin;
+		bvh[current].count = end - begin;
+		return;
+	}
+
+	int axis;
+	(cmaxx - cminn).maxCoeff(&axis);
+	int mid = (begin + end) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+		[&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+	int left = (int)bvh.size();
+	bvh[current].start = left;
+	bvh[current].count = 0;
+	bvh.push_back(BVHNode());
+	bvh.push_back(BVHNode());
+
+	buildRec(left, begin, mid, centers);
+	buildRec(left + 1, mid, end, centers);
+}
+
+void SwitchIndex::query(const Point& viewpoint, std::vector<int>& candidates) const
+{
+	candidates.clear();
+	if (bvh.empty())
+		return;
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const BVHNode& node = bvh[stack[--top]];
+		if ((viewpoint.array() < node.minn.array()).any() || (viewpoint.array() > node.maxx.array()).any())
+			continue;
+
+		if (node.count == 0)
+		{
+			stack[top++] = node.start;
+			stack[top++] = node.start + 1;
+			continue;
+		}
+
+		for (int i = node.start; i < node.start + node.count; i++)
+		{
+			if ((viewpoint.array() < item_minn[i].array()).any() || (viewpoint.array() > item_maxx[i].array()).any())
+				continue;
+			candidates.push_back(items[i]);
+		}
+	}
+}
+
+int SwitchIndex::expandToSize(
+	float target_size,
+	Point viewpoint,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	if (target_size != this->target_size || bvh.empty())
+		return Traversal::expandToSize(N, target_size, nodes, boxes, viewpoint, render_indices, nullptr, parent_indices, nodes_for_render_indices, frustum);
+
+	query(viewpoint, cut);
+
+	// Keep the node id order of the linear scan
+	std::sort(cut.begin(), cut.end());
+
+	float t2 = Traversal::squaredTarget(target_size);
+	counts.resize(cut.size());
+	int num_cut = 0;
+	for (int i = 0; i < (int)cut.size(); i++)
+	{
+		int idx = cut[i];
+		int count = Traversal::countForSize(nodes, boxes, idx, viewpoint, t2);
+		if (count == 0 || (frustum != nullptr && !frustum->intersects(boxes[idx])))
+			continue;
+		cut[num_cut] = idx;
+		counts[num_cut] = count;
+		num_cut++;
+	}
+
+	return Traversal::putRenderIndices(nodes, num_cut, cut.data(), counts.data(), render_indices, parent_indices, nodes_for_render_indices);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <vector>
+#include "common.h"
+
+struct Frustum;
+
+// Bounding volume hierarchy over the switch regions of all nodes for one target
+// size. A node can only be part of the cut when the viewpoint lies in its own
+// or its parent's switch sphere (radius max extent / target size around the
+// node center) or inside one of the two boxes. Each node is indexed by the
+// bounds of that region, so a query only visits the nodes around the current
+// cut instead of scanning all N nodes. This pays off when the cut is small
+// compared to the hierarchy, e.g. coarse targets or large scenes.
+//
+// The index is tied to the target size it was built for. expandToSize() falls
+// back to the linear scan of Traversal::expandToSize when asked for another one.
+class SwitchIndex
+{
+public:
+	void build(int N, Node* nodes, Box* boxes, float target_size);
+
+	bool valid() const { return N > 0; }
+	float targetSize() const { return target_size; }
+
+	// Same outputs as Traversal::expandToSize, ordered by node id
+	int expandToSize(
+		float target_size,
+		Point viewpoint,
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr,
+		const Frustum* frustum = nullptr);
+
+	// Nodes whose switch region contains the viewpoint, superset of the cut
+	void query(const Point& viewpoint, std::vector<int>& candidates) const;
+
+private:
+
+	struct BVHNode
+	{
+		Eigen::Vector3f minn, maxx;
+		// Leaves reference items[start, start + count), inner nodes have count 0
+		// and their children at start and start + 1
+		int start;
+		int count;
+	};
+
+	void buildRec(int current, int begin, int end, const std::vector<Eigen::Vector3f>& centers);
+
+	int N = 0;
+	Node* nodes = nullptr;
+	Box* boxes = nullptr;
+	float target_size = -1.0f;
+
+	std::vector<BVHNode> bvh;
+	std::vector<int> items;
+	std::vector<Eigen::Vector3f> item_minn, item_maxx;
+
+	std::vector<int> cut;
+	std::vector<int> counts;
+};
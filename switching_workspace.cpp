@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#include "switching_workspace.h"
+#include <cstdlib>
+#include <stdexcept>
+
+void* CPUWorkspaceBackend::allocate(size_t bytes)
+{
+	return std::malloc(bytes);
+}
+
+void CPUWorkspaceBackend::release(void* ptr)
+{
+	std::free(ptr);
+}
+
+void* CPUWorkspaceBackend::allocateHost(size_t bytes)
+{
+	return std::malloc(bytes);
+}
+
+void CPUWorkspaceBackend::releaseHost(void* ptr)
+{
+	std::free(ptr);
+}
+
+SwitchingWorkspace::SwitchingWorkspace(std::shared_ptr<WorkspaceBackend> backend) :
+	backend(std::move(backend))
+{
+}
+
+SwitchingWorkspace::~SwitchingWorkspace()
+{
+	release();
+}
+
+void SwitchingWorkspace::release()
+{
+	if (max_n == 0)
+		return;
+
+	backend->release(count_buffer);
+	backend->release(offset_buffer);
+	backend->release(flag_buffer);
+	if (scratch_buffer)
+		backend->release(scratch_buffer);
+	backend->release(device_result);
+	backend->releaseHost(host_result);
+
+	count_buffer = offset_buffer = device_result = host_result = nullptr;
+	flag_buffer = scratch_buffer = nullptr;
+	max_n = 0;
+	scratch_bytes = 0;
+}
+
+bool SwitchingWorkspace::reserve(int maxN)
+{
+	if (maxN <= max_n)
+		return false;
+
+	release();
+
+	// The scratch has to fit every scan and selection over the full capacity
+	size_t needed = backend->scratchBytes(maxN);
+
+	count_buffer = (int*)backend->allocate(sizeof(int) * maxN);
+	offset_buffer = (int*)backend->allocate(sizeof(int) * maxN);
+	flag_buffer = (char*)backend->allocate(maxN);
+	scratch_buffer = needed > 0 ? (char*)backend->allocate(needed) : nullptr;
+	device_result = (int*)backend->allocate(sizeof(int) * WORKSPACE_RESULTS);
+	host_result = (int*)backend->allocateHost(sizeof(int) * WORKSPACE_RESULTS);
+
+	if (!count_buffer || !offset_buffer || !flag_buffer || (needed > 0 && !scratch_buffer) || !device_result || !host_result)
+	{
+		max_n = maxN; // so that release() frees the partial allocation
+		release();
+		throw std::runtime_error("Could not allocate switching workspace!");
+	}
+
+	max_n = maxN;
+	scratch_bytes = needed;
+	num_allocations++;
+	return true;
+}
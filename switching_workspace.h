@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#define WORKSPACE_RESULTS 4
+
+// Where the buffers of a SwitchingWorkspace live
+class WorkspaceBackend
+{
+public:
+	virtual ~WorkspaceBackend() {}
+
+	virtual void* allocate(size_t bytes) = 0;
+	virtual void release(void* ptr) = 0;
+
+	// Host memory the results are copied to, pinned for device backends
+	virtual void* allocateHost(size_t bytes) = 0;
+	virtual void releaseHost(void* ptr) = 0;
+
+	// Temporary storage of the scans and selections over up to maxN elements
+	virtual size_t scratchBytes(int maxN) = 0;
+
+	virtual bool isDevice() const = 0;
+};
+
+// Plain host memory, the CPU traversal needs no scan scratch
+class CPUWorkspaceBackend : public WorkspaceBackend
+{
+public:
+	void* allocate(size_t bytes) override;
+	void release(void* ptr) override;
+	void* allocateHost(size_t bytes) override;
+	void releaseHost(void* ptr) override;
+	size_t scratchBytes(int maxN) override { return 0; }
+	bool isDevice() const override { return false; }
+};
+
+// Counts, offsets, flags and scratch for the expand and switching functions.
+// Buffers only grow: reserve() reallocates when maxN exceeds the capacity and
+// is a no-op otherwise, so one workspace sized for the largest hierarchy is
+// reused for every frame. Results are written to result() on the host; with a
+// device backend they are only valid once the stream passed to the expand
+// function has been synchronized.
+class SwitchingWorkspace
+{
+public:
+	SwitchingWorkspace(std::shared_ptr<WorkspaceBackend> backend);
+	~SwitchingWorkspace();
+
+	SwitchingWorkspace(const SwitchingWorkspace&) = delete;
+	SwitchingWorkspace& operator=(const SwitchingWorkspace&) = delete;
+
+	// Returns true if the buffers had to be reallocated
+	bool reserve(int maxN);
+	void release();
+
+	int capacity() const { return max_n; }
+	size_t scratchSize() const { return scratch_bytes; }
+	int allocations() const { return num_allocations; }
+	bool isDevice() const { return backend->isDevice(); }
+
+	int* counts() const { return count_buffer; }
+	int* offsets() const { return offset_buffer; }
+	char* flags() const { return flag_buffer; }
+	char* scratch() const { return scratch_buffer; }
+
+	// WORKSPACE_RESULTS ints in backend memory and their host copies
+	int* deviceResult() const { return device_result; }
+	int* result() const { return host_result; }
+
+private:
+	std::shared_ptr<WorkspaceBackend> backend;
+
+	int max_n = 0;
+	size_t scratch_bytes = 0;
+	int num_allocations = 0;
+
+	int* count_buffer = nullptr;
+	int* offset_buffer = nullptr;
+	char* flag_buffer = nullptr;
+	char* scratch_buffer = nullptr;
+	int* device_result = nullptr;
+	int* host_result = nullptr;
+};
@@ -84,6 +84,22 @@ torch::Tensor& render_indices,
 torch::Tensor& parent_indices,
 torch::Tensor& nodes_for_render_indices)
 {
+	if (!nodes.is_cuda())
+	{
+		torch::Tensor v = viewpoint.cpu().contiguous();
+		float* vp = v.data_ptr<float>();
+		return Traversal::expandToSize(
+		nodes.size(0),
+		size,
+		(Node*)nodes.contiguous().data_ptr<int>(),
+		(Box*)boxes.contiguous().data_ptr<float>(),
+		Point(vp[0], vp[1], vp[2]),
+		render_indices.contiguous().data_ptr<int>(),
+		nullptr,
+		parent_indices.contiguous().data_ptr<int>(),
+		nodes_for_render_indices.contiguous().data_ptr<int>());
+	}
+
 	return Switching::expandToSize(
 	nodes.size(0), 
 	size,
@@ -97,6 +113,156 @@ torch::Tensor& nodes_for_render_indices)
 	nodes_for_render_indices.contiguous().data_ptr<int>());
 }
 
+int ExpandToSizeFrustum(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoint, 
+torch::Tensor& viewproj, 
+float guard_band,
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices)
+{
+	if (nodes.is_cuda())
+		throw std::runtime_error("Frustum culled expansion is only available for CPU tensors!");
+
+	// Row-major (p @ M) matrices as used on the python side are column-major for Eigen
+	Eigen::Matrix4f M = Eigen::Map<Eigen::Matrix4f>(viewproj.cpu().contiguous().data_ptr<float>());
+	Frustum frustum(M, guard_band);
+
+	torch::Tensor v = viewpoint.cpu().contiguous();
+	float* vp = v.data_ptr<float>();
+	return Traversal::expandToSize(
+	nodes.size(0),
+	size,
+	(Node*)nodes.contiguous().data_ptr<int>(),
+	(Box*)boxes.contiguous().data_ptr<float>(),
+	Point(vp[0], vp[1], vp[2]),
+	render_indices.contiguous().data_ptr<int>(),
+	nullptr,
+	parent_indices.contiguous().data_ptr<int>(),
+	nodes_for_render_indices.contiguous().data_ptr<int>(),
+	&frustum);
+}
+
+int ExpandToSizeFoveated(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoint, 
+torch::Tensor& viewproj, 
+torch::Tensor& gaze, 
+float inner_radius,
+float outer_radius,
+float peripheral_scale,
+torch::Tensor& importance, 
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices)
+{
+	if (nodes.is_cuda())
+		throw std::runtime_error("Foveated expansion is only available for CPU tensors!");
+
+	Eigen::Matrix4f M = Eigen::Map<Eigen::Matrix4f>(viewproj.cpu().contiguous().data_ptr<float>());
+
+	// An empty importance map selects the gaze point falloff
+	torch::Tensor map = importance.cpu().contiguous();
+	torch::Tensor gz = gaze.cpu().contiguous();
+	float* g = gz.data_ptr<float>();
+	Foveation foveation = map.numel() == 0 ?
+		Foveation(M, Eigen::Vector2f(g[0], g[1]), inner_radius, outer_radius, peripheral_scale) :
+		Foveation(M, map.size(1), map.size(0), map.data_ptr<float>(), peripheral_scale);
+
+	torch::Tensor v = viewpoint.cpu().contiguous();
+	float* vp = v.data_ptr<float>();
+	return Traversal::expandToSizeFoveated(
+	nodes.size(0),
+	size,
+	(Node*)nodes.contiguous().data_ptr<int>(),
+	(Box*)boxes.contiguous().data_ptr<float>(),
+	Point(vp[0], vp[1], vp[2]),
+	foveation,
+	render_indices.contiguous().data_ptr<int>(),
+	nullptr,
+	parent_indices.contiguous().data_ptr<int>(),
+	nodes_for_render_indices.contiguous().data_ptr<int>());
+}
+
+int ExpandToSizeMultiView(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoints, 
+torch::Tensor& viewprojs, 
+float guard_band,
+torch::Tensor& render_indices,
+torch::Tensor& view_masks,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices)
+{
+	if (nodes.is_cuda())
+		throw std::runtime_error("Multi-view expansion is only available for CPU tensors!");
+
+	int K = viewpoints.size(0);
+	torch::Tensor vps = viewpoints.cpu().contiguous();
+	std::vector<Point> points(K);
+	for (int k = 0; k < K; k++)
+		points[k] = Eigen::Map<Point>(vps.data_ptr<float>() + 3 * k);
+
+	// An empty viewprojs tensor disables culling
+	std::vector<Frustum> frusta;
+	torch::Tensor vpms = viewprojs.cpu().contiguous();
+	if (vpms.numel() != 0)
+	{
+		for (int k = 0; k < K; k++)
+			frusta.push_back(Frustum(Eigen::Map<Eigen::Matrix4f>(vpms.data_ptr<float>() + 16 * k), guard_band));
+	}
+
+	return Traversal::expandToSizeMultiView(
+	nodes.size(0),
+	size,
+	(Node*)nodes.contiguous().data_ptr<int>(),
+	(Box*)boxes.contiguous().data_ptr<float>(),
+	K,
+	points.data(),
+	frusta.empty() ? nullptr : frusta.data(),
+	render_indices.contiguous().data_ptr<int>(),
+	(uint64_t*)view_masks.contiguous().data_ptr<int64_t>(),
+	parent_indices.contiguous().data_ptr<int>(),
+	nodes_for_render_indices.contiguous().data_ptr<int>());
+}
+
+std::tuple<int, float> ExpandToBudget(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+torch::Tensor& viewpoint, 
+int max_gaussians,
+int max_nodes,
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices)
+{
+	if (nodes.is_cuda())
+		throw std::runtime_error("Budgeted expansion is only available for CPU tensors!");
+
+	float reached_size;
+	torch::Tensor v = viewpoint.cpu().contiguous();
+	float* vp = v.data_ptr<float>();
+	int count = Traversal::expandToBudget(
+	nodes.size(0),
+	(Node*)nodes.contiguous().data_ptr<int>(),
+	(Box*)boxes.contiguous().data_ptr<float>(),
+	Point(vp[0], vp[1], vp[2]),
+	max_gaussians,
+	max_nodes,
+	render_indices.contiguous().data_ptr<int>(),
+	parent_indices.contiguous().data_ptr<int>(),
+	nodes_for_render_indices.contiguous().data_ptr<int>(),
+	reached_size);
+	return std::make_tuple(count, reached_size);
+}
+
 void GetTsIndexed(
 torch::Tensor& indices,
 float size,
@@ -107,6 +273,22 @@ torch::Tensor& viewdir,
 torch::Tensor& ts,
 torch::Tensor& num_kids)
 {
+	if (!nodes.is_cuda())
+	{
+		torch::Tensor v = viewpoint.cpu().contiguous();
+		float* vp = v.data_ptr<float>();
+		Traversal::getTsIndexed(
+		indices.size(0),
+		indices.contiguous().data_ptr<int>(),
+		size,
+		(Node*)nodes.contiguous().data_ptr<int>(),
+		(Box*)boxes.contiguous().data_ptr<float>(),
+		Point(vp[0], vp[1], vp[2]),
+		ts.contiguous().data_ptr<float>(),
+		num_kids.contiguous().data_ptr<int>());
+		return;
+	}
+
 	Switching::getTsIndexed(
 	indices.size(0),
 	indices.contiguous().data_ptr<int>(),
@@ -30,6 +30,54 @@ torch::Tensor& render_indices,
 torch::Tensor& parent_indices,
 torch::Tensor& nodes_for_render_indices);
 
+int ExpandToSizeFrustum(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoint, 
+torch::Tensor& viewproj, 
+float guard_band,
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices);
+
+int ExpandToSizeFoveated(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoint, 
+torch::Tensor& viewproj, 
+torch::Tensor& gaze, 
+float inner_radius,
+float outer_radius,
+float peripheral_scale,
+torch::Tensor& importance, 
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices);
+
+int ExpandToSizeMultiView(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+float size, 
+torch::Tensor& viewpoints, 
+torch::Tensor& viewprojs, 
+float guard_band,
+torch::Tensor& render_indices,
+torch::Tensor& view_masks,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices);
+
+std::tuple<int, float> ExpandToBudget(
+torch::Tensor& nodes, 
+torch::Tensor& boxes, 
+torch::Tensor& viewpoint, 
+int max_gaussians,
+int max_nodes,
+torch::Tensor& render_indices,
+torch::Tensor& parent_indices,
+torch::Tensor& nodes_for_render_indices);
+
 void GetTsIndexed(
 torch::Tensor& indices,
 float size,
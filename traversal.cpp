@@ -11,29 +11,697 @@
 
 
 #include "traversal.h"
+#include "parallel_scan.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
-void recExpand(int node_id, Node* nodes, std::vector<int>& indices, int target)
+void Traversal::computeTraversalOrder(Node* nodes, std::vector<int>& order)
 {
-	Node& node = nodes[node_id];
+	order.clear();
 
-	for (int i = 0; i < node.count_leafs; i++)
-		indices.push_back(node.start + i);
-
-	if (node.depth <= target) // We are below target. Nodes will not be expanded, content approximated
+	std::vector<int> stack(1, 0);
+	while (!stack.empty())
 	{
-		for (int i = 0; i < node.count_merged; i++)
-			indices.push_back(node.start + node.count_leafs + i);
+		int node_id = stack.back();
+		stack.pop_back();
+		order.push_back(node_id);
+
+		const Node& node = nodes[node_id];
+		for (int i = node.count_children - 1; i >= 0; i--)
+			stack.push_back(node.start_children + i);
 	}
-	else // we keep expanding and adding visible leaves
+}
+
+// A node is reached by the expansion iff its parent was expanded. Depth strictly
+// decreases towards the leaves, so this also holds for all further ancestors.
+static int countForTarget(const Node* nodes, int node_id, int target)
+{
+	const Node& node = nodes[node_id];
+	if (node.parent != -1 && nodes[node.parent].depth <= target)
+		return 0;
+
+	int count = node.count_leafs;
+	if (node.depth <= target) // We are below target. Nodes will not be expanded, content approximated
+		count += node.count_merged;
+	return count;
+}
+
+int Traversal::expandToTarget(
+	int N,
+	Node* nodes,
+	const int* order,
+	int target,
+	int* counts,
+	int* render_indices)
+{
+	if (N <= 0)
+		return 0;
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; i++)
+		counts[i] = countForTarget(nodes, order[i], target);
+
+	int total = inclusiveSum(counts, counts, N);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < N; i++)
 	{
-		for (int i = 0; i < node.count_children; i++)
-			recExpand(node.start_children + i, nodes, indices, target);
+		int offset = i == 0 ? 0 : counts[i - 1];
+		int count = counts[i] - offset;
+
+		int start = nodes[order[i]].start;
+		for (int j = 0; j < count; j++)
+			render_indices[offset + j] = start + j;
 	}
+
+	return total;
 }
 
 std::vector<int> Traversal::expandToTarget(Node* nodes, int target)
 {
-	std::vector<int> indices;
-	recExpand(0, nodes, indices, target);
+	std::vector<int> order;
+	computeTraversalOrder(nodes, order);
+
+	int N = order.size();
+	int num_gaussians = 0;
+	for (int i = 0; i < N; i++)
+		num_gaussians += nodes[order[i]].count_leafs + nodes[order[i]].count_merged;
+
+	std::vector<int> counts(N);
+	std::vector<int> indices(num_gaussians);
+	indices.resize(expandToTarget(N, nodes, order.data(), target, counts.data(), indices.data()));
 	return indices;
+}
+
+Frustum::Frustum(const Eigen::Matrix4f& viewproj, float guard_band)
+{
+	Eigen::Vector4f row0 = viewproj.row(0);
+	Eigen::Vector4f row1 = viewproj.row(1);
+	Eigen::Vector4f row2 = viewproj.row(2);
+	Eigen::Vector4f row3 = viewproj.row(3);
+	Eigen::Vector4f wide = (1.0f + guard_band) * row3;
+
+	planes[0] = wide + row0; // left
+	planes[1] = wide - row0; // right
+	planes[2] = wide + row1; // bottom
+	planes[3] = wide - row1; // top
+	planes[4] = row3 + row2; // near, z >= -w is conservative for both [-w, w] and [0, w] depth ranges
+	planes[5] = row3 - row2; // far
+}
+
+bool Frustum::intersects(const Box& box) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const Eigen::Vector4f& plane = planes[i];
+		float d = plane[3];
+		for (int j = 0; j < 3; j++)
+			d += plane[j] * (plane[j] >= 0 ? box.maxx[j] : box.minn[j]);
+		if (d < 0)
+			return false;
+	}
+	return true;
+}
+
+Foveation::Foveation(const Eigen::Matrix4f& viewproj, const Eigen::Vector2f& gaze, float inner_radius, float outer_radius, float peripheral_scale) :
+	viewproj(viewproj), gaze(gaze), inner_radius(inner_radius), outer_radius(outer_radius), peripheral_scale(peripheral_scale)
+{
+}
+
+Foveation::Foveation(const Eigen::Matrix4f& viewproj, int width, int height, const float* importance, float peripheral_scale) :
+	viewproj(viewproj), peripheral_scale(peripheral_scale), width(width), height(height), importance(importance)
+{
+}
+
+float Foveation::scale(const Point& point) const
+{
+	Eigen::Vector4f clip = viewproj * Eigen::Vector4f(point[0], point[1], point[2], 1.0f);
+	if (clip[3] <= 0)
+		return peripheral_scale;
+
+	Eigen::Vector2f ndc(clip[0] / clip[3], clip[1] / clip[3]);
+	if (std::abs(ndc[0]) > 1.0f || std::abs(ndc[1]) > 1.0f)
+		return peripheral_scale;
+
+	if (importance != nullptr)
+	{
+		int x = std::min(width - 1, (int)((ndc[0] + 1.0f) * 0.5f * width));
+		int y = std::min(height - 1, (int)((1.0f - ndc[1]) * 0.5f * height));
+		float value = importance[y * width + x];
+		return value * peripheral_scale > 1.0f ? 1.0f / value : peripheral_scale;
+	}
+
+	float r = (ndc - gaze).norm();
+	if (r <= inner_radius)
+		return 1.0f;
+	if (r >= outer_radius)
+		return peripheral_scale;
+	return 1.0f + (peripheral_scale - 1.0f) * (r - inner_radius) / (outer_radius - inner_radius);
+}
+
+bool Traversal::inbox(const Box& box, const Point& viewpoint)
+{
+	bool inside = true;
+	for (int i = 0; i < 3; i++)
+	{
+		inside &= viewpoint[i] >= box.minn[i] && viewpoint[i] <= box.maxx[i];
+	}
+	return inside;
+}
+
+float Traversal::computeSize(const Box& box, const Point& point, const Point& viewpoint)
+{
+	if (inbox(box, viewpoint))
+		return FLT_MAX;
+
+	Point diff = viewpoint - point;
+	float min_dist = sqrt(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2]);
+	return box.maxx[3] / min_dist;
+}
+
+void SwitchDistances::build(int N, const Node* nodes, const Box* boxes)
+{
+	x.resize(N);
+	y.resize(N);
+	z.resize(N);
+	radius2.resize(N);
+	bound2.resize(N);
+	parent_radius2.resize(N);
+	parent_bound2.resize(N);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Box& box = boxes[idx];
+		Point point = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		x[idx] = point[0];
+		y[idx] = point[1];
+		z[idx] = point[2];
+		radius2[idx] = box.maxx[3] * box.maxx[3];
+		// Small margin so that rounding never hides a viewpoint on the box surface
+		bound2[idx] = (box.maxx.head<3>() - point).cwiseMax(point - box.minn.head<3>()).squaredNorm() * 1.0001f;
+
+		int parent = nodes[idx].parent;
+		if (parent == -1)
+		{
+			parent_radius2[idx] = -1.0f;
+			parent_bound2[idx] = -1.0f;
+		}
+		else
+		{
+			const Box& pbox = boxes[parent];
+			parent_radius2[idx] = pbox.maxx[3] * pbox.maxx[3];
+			parent_bound2[idx] = (pbox.maxx.head<3>() - point).cwiseAbs().cwiseMax((point - pbox.minn.head<3>()).cwiseAbs()).squaredNorm() * 1.0001f;
+		}
+	}
+}
+
+static int countForReached(const Node& node, bool reached, bool parent_reached)
+{
+	int count = 0;
+	if (reached)
+		count = node.count_leafs;
+	else if (parent_reached)
+	{
+		count = node.count_leafs;
+		if (node.depth != 0)
+			count += node.count_merged;
+	}
+	return count;
+}
+
+int Traversal::countForSize(const Node* nodes, const Box* boxes, int node_id, const Point& viewpoint, float t2)
+{
+	const Node& node = nodes[node_id];
+	const Box& box = boxes[node_id];
+	Point diff = viewpoint - (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+	float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+
+	bool reached = reachesSize(box, dist2, t2, viewpoint);
+	bool parent_reached = !reached && node.parent != -1 && reachesSize(boxes[node.parent], dist2, t2, viewpoint);
+	return countForReached(node, reached, parent_reached);
+}
+
+int Traversal::putRenderIndices(
+	const Node* nodes,
+	int num_nodes,
+	const int* node_ids,
+	int* counts,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_for_render_indices)
+{
+	if (num_nodes <= 0)
+		return 0;
+
+	int total = inclusiveSum(counts, counts, num_nodes);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int idx = 0; idx < num_nodes; idx++)
+	{
+		int offset = idx == 0 ? 0 : counts[idx - 1];
+		int count = counts[idx] - offset;
+		if (count == 0)
+			continue;
+
+		int node_id = node_ids ? node_ids[idx] : idx;
+		const Node& node = nodes[node_id];
+		int parentgaussian = node.parent == -1 ? -1 : nodes[node.parent].start;
+		for (int i = 0; i < count; i++)
+		{
+			render_indices[offset + i] = node.start + i;
+			if (parent_indices)
+				parent_indices[offset + i] = parentgaussian;
+			if (nodes_for_render_indices)
+				nodes_for_render_indices[offset + i] = node_id;
+		}
+	}
+
+	return total;
+}
+
+template <typename CountFunc>
+static int expandWithCounts(
+	int N,
+	Node* nodes,
+	Box* boxes,
+	CountFunc countFor,
+	int* render_offsets,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	if (N <= 0)
+		return 0;
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		int count = countFor(idx);
+		// Cut nodes are disjoint subtrees, culling a cut node drops its whole subtree
+		if (count != 0 && frustum != nullptr && !frustum->intersects(boxes[idx]))
+			count = 0;
+		if (count != 0 && node_markers != nullptr)
+			node_markers[idx] = 1;
+		render_offsets[idx] = count;
+	}
+
+	return Traversal::putRenderIndices(nodes, N, nullptr, render_offsets, render_indices, parent_indices, nodes_for_render_indices);
+}
+
+int Traversal::expandToSize(
+	int N,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	Point viewpoint,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	float t2 = squaredTarget(target_size);
+	auto countFor = [&](int idx) {
+		return countForSize(nodes, boxes, idx, viewpoint, t2);
+	};
+	std::vector<int> render_offsets(std::max(N, 0));
+	return expandWithCounts(N, nodes, boxes, countFor, render_offsets.data(), render_indices, node_markers, parent_indices, nodes_for_render_indices, frustum);
+}
+
+int Traversal::expandToSize(
+	int N,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	Point viewpoint,
+	SwitchingWorkspace& workspace,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	if (workspace.isDevice())
+		throw std::runtime_error("CPU traversal needs a host workspace!");
+	if (workspace.capacity() < N)
+		throw std::runtime_error("Switching workspace is too small, reserve it for all nodes first!");
+
+	float t2 = squaredTarget(target_size);
+	auto countFor = [&](int idx) {
+		return countForSize(nodes, boxes, idx, viewpoint, t2);
+	};
+	int total = expandWithCounts(N, nodes, boxes, countFor, workspace.offsets(), render_indices, node_markers, parent_indices, nodes_for_render_indices, frustum);
+	if (workspace.result())
+		workspace.result()[0] = total;
+	return total;
+}
+
+int Traversal::expandToSizeFoveated(
+	int N,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	Point viewpoint,
+	const Foveation& foveation,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	float t2 = squaredTarget(target_size);
+	auto countFor = [&](int idx) {
+		const Node& node = nodes[idx];
+		const Box& box = boxes[idx];
+		Point center = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		Point diff = viewpoint - center;
+		float dist2 = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+
+		float s = foveation.scale(center);
+		bool reached = reachesSize(box, dist2, t2 * s * s, viewpoint);
+		bool parent_reached = false;
+		if (!reached && node.parent != -1)
+		{
+			const Box& pbox = boxes[node.parent];
+			float ps = foveation.scale((pbox.minn.head<3>() + pbox.maxx.head<3>()) / 2);
+			parent_reached = reachesSize(pbox, dist2, t2 * ps * ps, viewpoint);
+		}
+		return countForReached(node, reached, parent_reached);
+	};
+	std::vector<int> render_offsets(std::max(N, 0));
+	return expandWithCounts(N, nodes, boxes, countFor, render_offsets.data(), render_indices, node_markers, parent_indices, nodes_for_render_indices, frustum);
+}
+
+int Traversal::expandToSize(
+	int N,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	const SwitchDistances& distances,
+	Point viewpoint,
+	int* render_indices,
+	int* node_markers,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	const Frustum* frustum)
+{
+	float t2 = squaredTarget(target_size);
+	const float* x = distances.x.data();
+	const float* y = distances.y.data();
+	const float* z = distances.z.data();
+	const float* radius2 = distances.radius2.data();
+	const float* bound2 = distances.bound2.data();
+	const float* parent_radius2 = distances.parent_radius2.data();
+	const float* parent_bound2 = distances.parent_bound2.data();
+
+	auto countFor = [&](int idx) {
+		float dx = viewpoint[0] - x[idx], dy = viewpoint[1] - y[idx], dz = viewpoint[2] - z[idx];
+		float dist2 = dx * dx + dy * dy + dz * dz;
+		float scaled = dist2 * t2;
+
+		bool reached = scaled <= radius2[idx] || (dist2 <= bound2[idx] && inbox(boxes[idx], viewpoint));
+		bool parent_reached = false;
+		if (!reached && parent_radius2[idx] >= 0)
+		{
+			parent_reached = scaled <= parent_radius2[idx] ||
+				(dist2 <= parent_bound2[idx] && inbox(boxes[nodes[idx].parent], viewpoint));
+		}
+		if (!reached && !parent_reached)
+			return 0;
+		return countForReached(nodes[idx], reached, parent_reached);
+	};
+	std::vector<int> render_offsets(std::max(N, 0));
+	return expandWithCounts(N, nodes, boxes, countFor, render_offsets.data(), render_indices, node_markers, parent_indices, nodes_for_render_indices, frustum);
+}
+
+int Traversal::expandToSizeMultiView(
+	int N,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	int num_views,
+	const Point* viewpoints,
+	const Frustum* frusta,
+	int* render_indices,
+	uint64_t* view_masks,
+	int* parent_indices,
+	int* nodes_for_render_indices)
+{
+	if (num_views > MAX_BATCHED_VIEWS)
+		throw std::runtime_error("Too many views for one batch!");
+	if (N <= 0 || num_views <= 0)
+		return 0;
+
+	// Viewpoints as SoA so the per-view loops below vectorize
+	std::vector<float> vx(num_views), vy(num_views), vz(num_views);
+	for (int k = 0; k < num_views; k++)
+	{
+		vx[k] = viewpoints[k].x();
+		vy[k] = viewpoints[k].y();
+		vz[k] = viewpoints[k].z();
+	}
+
+	std::vector<uint64_t> leaf_masks(N), merged_masks(N);
+	std::vector<int> render_offsets(N);
+
+#pragma omp parallel for schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		const Node& node = nodes[idx];
+		const Box& box = boxes[idx];
+		float cx = (box.minn[0] + box.maxx[0]) / 2;
+		float cy = (box.minn[1] + box.maxx[1]) / 2;
+		float cz = (box.minn[2] + box.maxx[2]) / 2;
+
+		const Box& pbox = boxes[node.parent == -1 ? idx : node.parent];
+		bool has_parent = node.parent != -1;
+
+		float t2 = squaredTarget(target_size);
+		float radius2 = box.maxx[3] * box.maxx[3];
+		float parent_radius2 = pbox.maxx[3] * pbox.maxx[3];
+
+		char own[MAX_BATCHED_VIEWS], par[MAX_BATCHED_VIEWS];
+#pragma omp simd
+		for (int k = 0; k < num_views; k++)
+		{
+			float dx = vx[k] - cx, dy = vy[k] - cy, dz = vz[k] - cz;
+			float scaled = (dx * dx + dy * dy + dz * dz) * t2;
+
+			bool in = vx[k] >= box.minn[0] && vx[k] <= box.maxx[0] &&
+				vy[k] >= box.minn[1] && vy[k] <= box.maxx[1] &&
+				vz[k] >= box.minn[2] && vz[k] <= box.maxx[2];
+
+			bool pin = vx[k] >= pbox.minn[0] && vx[k] <= pbox.maxx[0] &&
+				vy[k] >= pbox.minn[1] && vy[k] <= pbox.maxx[1] &&
+				vz[k] >= pbox.minn[2] && vz[k] <= pbox.maxx[2];
+
+			own[k] = in || scaled <= radius2;
+			par[k] = has_parent && (pin || scaled <= parent_radius2);
+		}
+
+		uint64_t leaf_mask = 0, merged_mask = 0;
+		for (int k = 0; k < num_views; k++)
+		{
+			leaf_mask |= (uint64_t)(own[k] | par[k]) << k;
+			merged_mask |= (uint64_t)(!own[k] && par[k]) << k;
+		}
+		if (node.depth == 0)
+			merged_mask = 0;
+
+		if (frusta != nullptr && leaf_mask != 0)
+		{
+			for (int k = 0; k < num_views; k++)
+			{
+				if ((leaf_mask >> k) & 1 && !frusta[k].intersects(box))
+				{
+					leaf_mask &= ~((uint64_t)1 << k);
+					merged_mask &= ~((uint64_t)1 << k);
+				}
+			}
+		}
+
+		leaf_masks[idx] = leaf_mask;
+		merged_masks[idx] = merged_mask;
+		render_offsets[idx] = (leaf_mask ? node.count_leafs : 0) + (merged_mask ? node.count_merged : 0);
+	}
+
+	int total = inclusiveSum(render_offsets.data(), render_offsets.data(), N);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int idx = 0; idx < N; idx++)
+	{
+		int offset = idx == 0 ? 0 : render_offsets[idx - 1];
+		int count = render_offsets[idx] - offset;
+		if (count == 0)
+			continue;
+
+		const Node& node = nodes[idx];
+		int parentgaussian = node.parent == -1 ? -1 : nodes[node.parent].start;
+		for (int i = 0; i < count; i++)
+		{
+			render_indices[offset + i] = node.start + i;
+			view_masks[offset + i] = i < node.count_leafs ? leaf_masks[idx] : merged_masks[idx];
+			if (parent_indices)
+				parent_indices[offset + i] = parentgaussian;
+			if (nodes_for_render_indices)
+				nodes_for_render_indices[offset + i] = idx;
+		}
+	}
+
+	return total;
+}
+
+void Traversal::getTsIndexed(
+	int N,
+	const int* indices,
+	float target_size,
+	Node* nodes,
+	Box* boxes,
+	Point viewpoint,
+	float* ts,
+	int* kids)
+{
+	float vx = viewpoint.x(), vy = viewpoint.y(), vz = viewpoint.z();
+
+	// Branch-free version of computeTsIndexed so that the loop vectorizes
+#pragma omp parallel for simd schedule(static)
+	for (int idx = 0; idx < N; idx++)
+	{
+		int node_id = indices[idx];
+		const Node& node = nodes[node_id];
+		bool root = node.parent == -1;
+		int parent_id = root ? node_id : node.parent;
+
+		const Box& box = boxes[node_id];
+		const Box& pbox = boxes[parent_id];
+
+		float dx = vx - (box.minn[0] + box.maxx[0]) / 2;
+		float dy = vy - (box.minn[1] + box.maxx[1]) / 2;
+		float dz = vz - (box.minn[2] + box.maxx[2]) / 2;
+		float dist = sqrt(dx * dx + dy * dy + dz * dz);
+
+		bool in = vx >= box.minn[0] && vx <= box.maxx[0] &&
+			vy >= box.minn[1] && vy <= box.maxx[1] &&
+			vz >= box.minn[2] && vz <= box.maxx[2];
+		bool pin = vx >= pbox.minn[0] && vx <= pbox.maxx[0] &&
+			vy >= pbox.minn[1] && vy <= pbox.maxx[1] &&
+			vz >= pbox.minn[2] && vz <= pbox.maxx[2];
+
+		float size = in ? FLT_MAX : box.maxx[3] / dist;
+		float parentsize = pin ? FLT_MAX : pbox.maxx[3] / dist;
+
+		float start = std::max(0.5f * parentsize, size);
+		float diff = parentsize - start;
+		float tdiff = std::max(0.0f, target_size - start);
+		float t = std::max(1.0f - (tdiff / diff), 0.0f);
+
+		ts[idx] = (root || parentsize > 2.0f * target_size || diff <= 0) ? 1.0f : t;
+		kids[idx] = root ? 1 : nodes[parent_id].count_children;
+	}
+}
+
+struct Candidate
+{
+	float size;
+	int node_id;
+
+	bool operator<(const Candidate& other) const { return size < other.size; }
+};
+
+int Traversal::expandToBudget(
+	int N,
+	Node* nodes,
+	Box* boxes,
+	Point viewpoint,
+	int max_gaussians,
+	int max_nodes,
+	int* render_indices,
+	int* parent_indices,
+	int* nodes_for_render_indices,
+	float& reached_size,
+	const Frustum* frustum)
+{
+	reached_size = FLT_MAX;
+	if (N <= 0 || (frustum != nullptr && !frustum->intersects(boxes[0])))
+		return 0;
+
+	auto unexpandedCount = [&](int node_id) {
+		const Node& node = nodes[node_id];
+		return node.count_leafs + (node.depth != 0 ? node.count_merged : 0);
+	};
+	auto nodeSize = [&](int node_id) {
+		const Box& box = boxes[node_id];
+		Point point = (box.minn.head<3>() + box.maxx.head<3>()) / 2;
+		return computeSize(box, point, viewpoint);
+	};
+
+	// Settled cut nodes with the number of Gaussians they emit
+	std::vector<std::pair<int, int>> cut;
+	std::vector<Candidate> queue;
+
+	auto addToCut = [&](int node_id) {
+		const Node& node = nodes[node_id];
+		if (node.depth == 0 || node.start_children == -1)
+			cut.push_back(std::make_pair(node_id, unexpandedCount(node_id)));
+		else
+		{
+			queue.push_back({ nodeSize(node_id), node_id });
+			std::push_heap(queue.begin(), queue.end());
+		}
+	};
+
+	int total = unexpandedCount(0);
+	int num_nodes = 1;
+	addToCut(0);
+
+	while (!queue.empty())
+	{
+		int node_id = queue.front().node_id;
+		const Node& node = nodes[node_id];
+
+		int new_total = total - node.count_merged;
+		int new_nodes = num_nodes - (node.count_leafs == 0 ? 1 : 0);
+		for (int i = 0; i < node.count_children; i++)
+		{
+			int child_id = node.start_children + i;
+			if (frustum != nullptr && !frustum->intersects(boxes[child_id]))
+				continue;
+			new_total += unexpandedCount(child_id);
+			new_nodes++;
+		}
+		if (new_total > max_gaussians || (max_nodes > 0 && new_nodes > max_nodes))
+			break;
+
+		std::pop_heap(queue.begin(), queue.end());
+		queue.pop_back();
+		total = new_total;
+		num_nodes = new_nodes;
+
+		if (node.count_leafs != 0)
+			cut.push_back(std::make_pair(node_id, node.count_leafs));
+		for (int i = 0; i < node.count_children; i++)
+		{
+			int child_id = node.start_children + i;
+			if (frustum == nullptr || frustum->intersects(boxes[child_id]))
+				addToCut(child_id);
+		}
+	}
+
+	reached_size = queue.empty() ? 0.0f : queue.front().size;
+	for (const Candidate& candidate : queue)
+		cut.push_back(std::make_pair(candidate.node_id, unexpandedCount(candidate.node_id)));
+
+	std::sort(cut.begin(), cut.end());
+
+	std::vector<int> cut_ids(cut.size()), cut_counts(cut.size());
+	for (size_t k = 0; k < cut.size(); k++)
+	{
+		cut_ids[k] = cut[k].first;
+		cut_counts[k] = cut[k].second;
+	}
+	return putRenderIndices(nodes, (int)cut.size(), cut_ids.data(), cut_counts.data(), render_indices, parent_indices, nodes_for_render_indices);
 }
\ No newline at end of file
@@ -12,10 +12,219 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include "common.h"
+#include "switching_workspace.h"
+
+#define MAX_BATCHED_VIEWS 64
+
+// View frustum extracted from a view-projection matrix (column vectors,
+// clip = viewproj * [p, 1]). The clip-space extent in x and y can be widened by
+// a relative guard band so that content just outside the screen is kept.
+struct Frustum
+{
+	Frustum(const Eigen::Matrix4f& viewproj, float guard_band = 0.0f);
+
+	// Conservative, true unless the box is completely outside one of the planes
+	bool intersects(const Box& box) const;
+
+	Eigen::Vector4f planes[6];
+};
+
+// Screen position dependent scale of the target size for foveated traversal.
+// Points are projected with viewproj (same convention as Frustum). Around a
+// gaze point in NDC the scale is 1 up to inner_radius and rises linearly to
+// peripheral_scale at outer_radius. With an importance map instead (width x
+// height, row-major, first row at the top of the screen, values in (0, 1]) the
+// scale is 1 / importance, clamped to peripheral_scale. The map is not copied.
+// Points behind the camera or off screen use peripheral_scale.
+struct Foveation
+{
+	Foveation(const Eigen::Matrix4f& viewproj, const Eigen::Vector2f& gaze, float inner_radius, float outer_radius, float peripheral_scale);
+	Foveation(const Eigen::Matrix4f& viewproj, int width, int height, const float* importance, float peripheral_scale);
+
+	float scale(const Point& point) const;
+
+	Eigen::Matrix4f viewproj;
+	Eigen::Vector2f gaze = Eigen::Vector2f::Zero();
+	float inner_radius = 0.0f;
+	float outer_radius = 0.0f;
+	float peripheral_scale;
+	int width = 0;
+	int height = 0;
+	const float* importance = nullptr;
+};
+
+// Per-node data for size tests without sqrt, as SoA. Build once after loading.
+// size >= target_size  <=>  dist2 * target_size^2 <= radius2, or the viewpoint
+// is inside the box, which is only possible when dist2 <= bound2.
+struct SwitchDistances
+{
+	void build(int N, const Node* nodes, const Box* boxes);
+
+	std::vector<float> x, y, z; // box centers
+	std::vector<float> radius2; // squared max extent of the box
+	std::vector<float> bound2; // squared half diagonal of the box
+	std::vector<float> parent_radius2; // same for the parent box, -1 for the root
+	std::vector<float> parent_bound2; // squared distance from the center to the farthest parent box corner
+};
 
 class Traversal
 {
 public:
+	static bool inbox(const Box& box, const Point& viewpoint);
+
+	// Same metric as computeSizeGPU, FLT_MAX if the viewpoint is inside the box
+	static float computeSize(const Box& box, const Point& point, const Point& viewpoint);
+
+	// computeSize(box, point, viewpoint) >= target_size, written as a squared
+	// comparison. dist2 is the squared distance to point, t2 = squaredTarget(target_size).
+	static bool reachesSize(const Box& box, float dist2, float t2, const Point& viewpoint)
+	{
+		return dist2 * t2 <= box.maxx[3] * box.maxx[3] || inbox(box, viewpoint);
+	}
+
+	static float squaredTarget(float target_size)
+	{
+		return target_size > 0 ? target_size * target_size : 0.0f;
+	}
+
+	// Number of Gaussians node_id contributes to the cut of expandToSize
+	static int countForSize(const Node* nodes, const Box* boxes, int node_id, const Point& viewpoint, float t2);
+
+	// CPU equivalent of putRenderIndicesIndexed. counts holds the number of
+	// Gaussians of each of the num_nodes cut nodes and is turned into their end
+	// offsets in place. node_ids lists the cut nodes, nullptr for 0..num_nodes-1
+	// (nodes with a count of 0 are skipped). Returns the number of indices written.
+	static int putRenderIndices(
+		const Node* nodes,
+		int num_nodes,
+		const int* node_ids,
+		int* counts,
+		int* render_indices,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr);
+
 	static std::vector<int>  expandToTarget(Node* nodes, int target);
-};
\ No newline at end of file
+
+	// Depth-first order of all nodes reachable from the root, the order in which
+	// expandToTarget emits Gaussians. Compute once per hierarchy and reuse.
+	static void computeTraversalOrder(Node* nodes, std::vector<int>& order);
+
+	// Flat version of expandToTarget over a precomputed traversal order of N nodes.
+	// counts is scratch space for N ints, render_indices must hold every Gaussian
+	// of the hierarchy. Nothing is allocated, returns the number of indices written.
+	static int expandToTarget(
+		int N,
+		Node* nodes,
+		const int* order,
+		int target,
+		int* counts,
+		int* render_indices);
+
+	// CPU equivalent of Switching::expandToSize, same outputs in the same order.
+	// With a frustum, nodes of the cut whose box is outside of it are dropped.
+	static int expandToSize(
+		int N,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		Point viewpoint,
+		int* render_indices,
+		int* node_markers = nullptr,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr,
+		const Frustum* frustum = nullptr);
+
+	// Same as above with the offsets taken from a host workspace reserved for at
+	// least N nodes instead of a per-call allocation. The count is also written
+	// to workspace.result()[0], as with the device workspace.
+	static int expandToSize(
+		int N,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		Point viewpoint,
+		SwitchingWorkspace& workspace,
+		int* render_indices,
+		int* node_markers = nullptr,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr,
+		const Frustum* frustum = nullptr);
+
+	// Same as above, but the size tests read the precomputed switch distances and
+	// only touch the boxes for nodes close to the viewpoint
+	static int expandToSize(
+		int N,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		const SwitchDistances& distances,
+		Point viewpoint,
+		int* render_indices,
+		int* node_markers = nullptr,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr,
+		const Frustum* frustum = nullptr);
+
+	// expandToSize with the target size scaled by the foveation at the projected
+	// node center. The parent test uses the scale at the parent center.
+	static int expandToSizeFoveated(
+		int N,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		Point viewpoint,
+		const Foveation& foveation,
+		int* render_indices,
+		int* node_markers = nullptr,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr,
+		const Frustum* frustum = nullptr);
+
+	// expandToSize for up to MAX_BATCHED_VIEWS viewpoints (and optional frusta) in
+	// one pass over the nodes. Writes the union of all cuts; bit k of view_masks
+	// tells whether an index belongs to the cut of view k, which then equals the
+	// single view result for that viewpoint.
+	static int expandToSizeMultiView(
+		int N,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		int num_views,
+		const Point* viewpoints,
+		const Frustum* frusta,
+		int* render_indices,
+		uint64_t* view_masks,
+		int* parent_indices = nullptr,
+		int* nodes_for_render_indices = nullptr);
+
+	// CPU equivalent of Switching::getTsIndexed, interpolation weight towards the
+	// parent and number of siblings for each of the N given nodes
+	static void getTsIndexed(
+		int N,
+		const int* indices,
+		float target_size,
+		Node* nodes,
+		Box* boxes,
+		Point viewpoint,
+		float* ts,
+		int* kids);
+
+	// Greedy refinement from the root, always splitting the cut node with the
+	// largest projected size, until the next split would exceed max_gaussians
+	// (or max_nodes cut nodes, if > 0). Output as for expandToSize, reached_size
+	// is the size threshold that the returned cut effectively corresponds to.
+	static int expandToBudget(
+		int N,
+		Node* nodes,
+		Box* boxes,
+		Point viewpoint,
+		int max_gaussians,
+		int max_nodes,
+		int* render_indices,
+		int* parent_indices,
+		int* nodes_for_render_indices,
+		float& reached_size,
+		const Frustum* frustum = nullptr);
+};
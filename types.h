@@ -65,4 +65,25 @@ struct HalfNode
 	int start;
 	int start_children;
 	short dccc[4];
-};
\ No newline at end of file
+};
+
+// Runtime Gaussian with half precision attributes, 100 instead of 236 bytes.
+// Scale, rotation and opacity also carry the values of the first Gaussian of
+// the parent node (the one parent_indices point to) for interpolation, scale
+// as (own, parent) pairs like the half2 of Maintenance::compress. The 45
+// higher order SH coefficients are quantized to 8 bits against a per Gaussian
+// half precision scale, the DC terms stay half. Halves are stored as raw bits.
+// Only the format and its codec (pack, MaintenanceCPU::unpack) live here: the
+// maintenance and switching functions keep working on the float spaces, a
+// renderer builds the packed space from them and reads it instead.
+struct PackedGaussian
+{
+	float position[3];
+	unsigned short scale[3][2];
+	unsigned short rotation[2][4];
+	unsigned short opacity[2];
+	unsigned short sh_dc[3];
+	unsigned short sh_scale;
+	signed char sh_rest[45];
+	signed char padding[3];
+};